@@ -2,6 +2,62 @@
 #include "../../google_benchmark/include/benchmark/benchmark.h"
 #include "../papso2/executor.h"
 #include "../papso2/papso2_test.h"
+#include "../papso2/simulated_objective.h"
+#include "../papso2/process_objective.h"
+#include "../papso2/cooperative_papso.h"
+#include "../papso2/batch_papso.h"
+#include "../papso2/shm_migration.h"
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Data TLB misses of this process (all threads spawned afterwards included)
+// Reads 0 where perf events are unavailable
+class tlb_miss_counter {
+	int fd_ = -1;
+public:
+	tlb_miss_counter() {
+#if defined(__linux__)
+		perf_event_attr attr{};
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = PERF_COUNT_HW_CACHE_DTLB
+			| (PERF_COUNT_HW_CACHE_OP_READ << 8)
+			| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		attr.disabled = 1;
+		attr.inherit = 1;
+		attr.exclude_kernel = 1;
+		fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+	}
+	~tlb_miss_counter() {
+#if defined(__linux__)
+		if (fd_ >= 0) close(fd_);
+#endif
+	}
+	void start() {
+#if defined(__linux__)
+		if (fd_ >= 0) {
+			ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+	long long stop() {
+		long long count = 0;
+#if defined(__linux__)
+		if (fd_ >= 0) {
+			ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+			if (sizeof(count) != read(fd_, &count, sizeof(count))) count = 0;
+		}
+#endif
+		return count;
+	}
+};
 
 
 template <size_t Scale> requires (Scale > 0)
@@ -81,6 +137,34 @@ static void benchmark_papso(benchmark::State& state) {
 //->Args({ 16, 200, 8 }) // 3 * 200
 //->Args({ 24, 100, 8 }); // 2 * 100
 
+// Granularity picked at runtime instead
+// Args: [fork_count] [task_duration_us] [thread_count]
+static void benchmark_adaptive_granularity(benchmark::State& state) {
+	using papso_t = basic_papso<hungbiu::spmc_buffer<vec_t>, 2, 48, 5000>;
+
+	size_t fork_count = state.range(0);
+	papso_options options;
+	options.task_duration = std::chrono::microseconds{ state.range(1) };
+	hungbiu::hb_executor etor{ static_cast<size_t>(state.range(2)) };
+
+	const optimization_problem_t problem = scaled_rosenbrock<50>::problem;
+
+	size_t tasks = 0;
+	for (auto _ : state) {
+		auto result = papso_t::parallel_async_pso(etor, fork_count, 100, problem, options);
+		benchmark::DoNotOptimize(result.get());
+		tasks += result.stats().tasks;
+	}
+	state.counters["tasks"] = benchmark::Counter(static_cast<double>(tasks), benchmark::Counter::kAvgIterations);
+}
+//BENCHMARK(benchmark_adaptive_granularity)
+//->Iterations(1)
+//->Repetitions(10)
+//->Unit(benchmark::kMillisecond)
+//->Args({ 8, 200, 8 })
+//->Args({ 16, 200, 8 })
+//->Args({ 24, 200, 8 });
+
 //BENCHMARK(benchmark_papso)
 //->Iterations(1)
 //->Repetitions(5)
@@ -97,6 +181,600 @@ static void benchmark_papso(benchmark::State& state) {
 //->Args({ 6, 500, 6, 1 })
 //->Args({ 8, 500, 8, 1 });
 
+// Many short jobs, fresh state per job vs. a pooled state
+// Args: [fork_count] [iter_per_task] [thread_count]
+template <bool Pooled>
+static void benchmark_short_jobs(benchmark::State& state) {
+	using papso_t = basic_papso<hungbiu::spmc_buffer<vec_t>, 2, 40, 100>;
+
+	size_t fork_count = state.range(0);
+	size_t iter_per_task = state.range(1);
+	hungbiu::hb_executor etor{ static_cast<size_t>(state.range(2)) };
+	papso_t::state_pool pool;
+
+	const optimization_problem_t problem{
+		test_functions::functions[0]
+		, test_functions::bounds[0]
+		, test_functions::dimensions[0]
+	};
+
+	for (auto _ : state) {
+		auto result = Pooled
+			? papso_t::parallel_async_pso(etor, pool, fork_count, iter_per_task, problem)
+			: papso_t::parallel_async_pso(etor, fork_count, iter_per_task, problem);
+		benchmark::DoNotOptimize(result.get());
+	}
+}
+//BENCHMARK_TEMPLATE(benchmark_short_jobs, false)
+//->Unit(benchmark::kMicrosecond)
+//->Args({ 4, 50, 4 });
+//BENCHMARK_TEMPLATE(benchmark_short_jobs, true)
+//->Unit(benchmark::kMicrosecond)
+//->Args({ 4, 50, 4 });
+
+// Large swarm memory backing, TLB misses and memory use reported per run
+// Args: [memory_policy] [bind_subswarms] [compact] [dimensions] [fork_count]
+static void benchmark_large_swarm(benchmark::State& state) {
+	using papso_t = basic_papso<hungbiu::spmc_buffer<vec_t>, 2, 10000, 20>;
+
+	papso_options options;
+	options.memory = static_cast<hungbiu::memory_policy>(state.range(0));
+	options.bind_subswarms = static_cast<bool>(state.range(1));
+	options.compact = static_cast<bool>(state.range(2));
+	const optimization_problem_t problem{
+		test_functions::functions[0]
+		, test_functions::bounds[0]
+		, static_cast<size_t>(state.range(3))
+	};
+	const size_t fork_count = static_cast<size_t>(state.range(4));
+	// Counter must exist before the workers to inherit into them
+	tlb_miss_counter tlb_misses;
+	hungbiu::hb_executor etor(fork_count);
+
+	long long misses = 0;
+	size_t memory_bytes = 0;
+	for (auto _ : state) {
+		tlb_misses.start();
+		auto result = papso_t::parallel_async_pso(etor, fork_count, 5, problem, options);
+		benchmark::DoNotOptimize(result.get());
+		misses += tlb_misses.stop();
+		memory_bytes = result.stats().memory_bytes;
+	}
+	state.counters["dTLB-misses"] = benchmark::Counter(static_cast<double>(misses), benchmark::Counter::kAvgIterations);
+	state.counters["memory_MiB"] = static_cast<double>(memory_bytes) / (1 << 20);
+}
+//BENCHMARK(benchmark_large_swarm)
+//->Unit(benchmark::kMillisecond)->Iterations(3)
+//->Args({ 0, 0, 0, 1000, 8 }) // standard
+//->Args({ 1, 0, 0, 1000, 8 }) // huge pages
+//->Args({ 1, 1, 0, 1000, 8 }) // huge pages + NUMA binding
+//->Args({ 0, 0, 1, 1000, 8 }) // compact
+//->Args({ 1, 1, 1, 1000, 8 }); // all of the above
+
+// Objective with 500us latency, blocking a worker vs. pipelined asynchronous evaluation
+// Args: [fork_count] [thread_count] [evaluations_in_flight]
+template <bool Async>
+static void benchmark_async_objective(benchmark::State& state) {
+	using papso_t = basic_papso<hungbiu::spmc_buffer<vec_t>, 2, 40, 200>;
+	static constexpr auto rastrigin = test_functions::functions[4];
+
+	simulated_latency_objective simulator{ rastrigin, std::chrono::microseconds{ 500 } };
+	const optimization_problem_t problem{
+		blocking_latency_objective<rastrigin, 500>::function
+		, test_functions::bounds[4]
+		, test_functions::dimensions[4]
+		, Async ? &simulator : nullptr
+	};
+	papso_options options;
+	options.evaluations_in_flight = static_cast<size_t>(state.range(2));
+
+	size_t fork_count = static_cast<size_t>(state.range(0));
+	hungbiu::hb_executor etor(static_cast<size_t>(state.range(1)));
+	for (auto _ : state) {
+		auto result = papso_t::parallel_async_pso(etor, fork_count, 50, problem, options);
+		benchmark::DoNotOptimize(result.get());
+	}
+}
+//BENCHMARK_TEMPLATE(benchmark_async_objective, false)
+//->Unit(benchmark::kMillisecond)->Iterations(1)->Repetitions(3)
+//->Args({ 4, 4, 1 });
+//BENCHMARK_TEMPLATE(benchmark_async_objective, true)
+//->Unit(benchmark::kMillisecond)->Iterations(1)->Repetitions(3)
+//->Args({ 4, 4, 1 })
+//->Args({ 4, 4, 4 })
+//->Args({ 4, 4, 10 });
+
+// Costly objective with and without an evaluation cache
+// Args: [tolerance as -log10, 0 disables the cache] [thread_count]
+static void benchmark_evaluation_cache(benchmark::State& state) {
+	using papso_t = basic_papso<hungbiu::spmc_buffer<vec_t>, 2, 40, 500>;
+	static constexpr auto schwefel_26 = test_functions::functions[3];
+	const optimization_problem_t problem{
+		blocking_latency_objective<schwefel_26, 50>::function
+		, test_functions::bounds[3]
+		, test_functions::dimensions[3]
+	};
+
+	const auto digits = state.range(0);
+	evaluation_cache cache{ 1 << 16, digits ? std::pow(10., -static_cast<double>(digits)) : 0. };
+	papso_options options;
+	options.cache = digits ? &cache : nullptr;
+
+	const size_t thread_count = static_cast<size_t>(state.range(1));
+	hungbiu::hb_executor etor(thread_count);
+	double best = 0, hits = 0, lookups = 0, saved_ms = 0;
+	for (auto _ : state) {
+		cache.clear();
+		auto result = papso_t::parallel_async_pso(etor, thread_count, 50, problem, options);
+		best += std::get<0>(result.get());
+		const papso_stats& stats = result.stats();
+		hits += stats.cache_hits;
+		lookups += stats.cache_hits + stats.cache_misses;
+		saved_ms += std::chrono::duration<double, std::milli>(stats.cache_saved_time).count();
+	}
+	state.counters["best"] = benchmark::Counter(best, benchmark::Counter::kAvgIterations);
+	state.counters["hit_rate"] = lookups ? hits / lookups : 0;
+	state.counters["saved_ms"] = benchmark::Counter(saved_ms, benchmark::Counter::kAvgIterations);
+}
+//BENCHMARK(benchmark_evaluation_cache)
+//->Unit(benchmark::kMillisecond)->Iterations(3)
+//->Args({ 0, 4 })->Args({ 9, 4 })->Args({ 6, 4 })->Args({ 3, 4 });
+
+// Plain vs. incremental evaluation of separable test functions
+// Args: [0 sphere, 1 schwefel 2.6, 2 rastrigin] [dimensions] [separable on/off] [threshold as -log10, 0 exact]
+static void benchmark_separable(benchmark::State& state) {
+	using papso_t = basic_papso<hungbiu::spmc_buffer<vec_t>, 2, 40, 200>;
+	static constexpr size_t indices[] = { 0, 3, 4 };
+	static constexpr separable_objective separables[] = {
+		{ test_functions::sphere_term }
+		, { test_functions::schwefel_26_term, test_functions::schwefel_26_finalize }
+		, { test_functions::rastrigin_term }
+	};
+	const auto which = state.range(0);
+	const size_t idx = indices[which];
+	const optimization_problem_t problem{
+		test_functions::functions[idx]
+		, test_functions::bounds[idx]
+		, static_cast<size_t>(state.range(1))
+		, nullptr
+		, state.range(2) ? separables[which] : separable_objective{}
+	};
+	papso_options options;
+	options.separable_threshold = state.range(3) ? std::pow(10., -static_cast<double>(state.range(3))) : 0.;
+
+	hungbiu::hb_executor etor(4);
+	double best = 0;
+	for (auto _ : state) {
+		auto result = papso_t::parallel_async_pso(etor, 4, 20, problem, options);
+		best += std::get<0>(result.get());
+	}
+	state.counters["best"] = benchmark::Counter(best, benchmark::Counter::kAvgIterations);
+}
+//BENCHMARK(benchmark_separable)
+//->Unit(benchmark::kMillisecond)->Iterations(1)->Repetitions(3)
+//->ArgsProduct({ { 0, 1, 2 }, { 10000, 100000 }, { 0, 1 }, { 0 } })
+//->ArgsProduct({ { 0, 1, 2 }, { 10000, 100000 }, { 1 }, { 3, 1 } });
+
+// Particle-parallel vs. dimension-parallel (cooperative) on separable rastrigin
+// Args: [dimensions] [thread_count] [cooperative on/off]
+static void benchmark_cooperative(benchmark::State& state) {
+	const optimization_problem_t problem{
+		test_functions::rastrigin
+		, test_functions::bounds[4]
+		, static_cast<size_t>(state.range(0))
+		, nullptr
+		, { test_functions::rastrigin_term }
+	};
+
+	const size_t thread_count = static_cast<size_t>(state.range(1));
+	hungbiu::hb_executor etor(thread_count);
+	double best = 0;
+	for (auto _ : state) {
+		if (state.range(2)) {
+			auto result = cooperative_papso::parallel_cooperative_pso(etor, thread_count, 50, problem);
+			best += std::get<0>(result.get());
+		}
+		else {
+			auto result = papso::parallel_async_pso(etor, thread_count, 50, problem);
+			best += std::get<0>(result.get());
+		}
+	}
+	state.counters["best"] = benchmark::Counter(best, benchmark::Counter::kAvgIterations);
+}
+//BENCHMARK(benchmark_cooperative)
+//->Unit(benchmark::kMillisecond)->Iterations(1)->Repetitions(3)
+//->ArgsProduct({ { 1000, 100000 }, { 4, 16 }, { 0, 1 } });
+
+// Quality and throughput of single vs. double precision particle state
+// Args: [function idx] [dimensions] [thread_count]
+template <typename Real>
+static void benchmark_precision(benchmark::State& state) {
+	using papso_t = basic_papso<hungbiu::spmc_buffer<std::vector<Real>>, 2, 40, 1000, Real>;
+	const auto idx = state.range(0);
+	const optimization_problem_t problem{
+		test_functions::functions[idx]
+		, test_functions::bounds[idx]
+		, static_cast<size_t>(state.range(1))
+	};
+
+	const size_t thread_count = static_cast<size_t>(state.range(2));
+	hungbiu::hb_executor etor(thread_count);
+	double best = 0, memory = 0;
+	for (auto _ : state) {
+		auto result = papso_t::parallel_async_pso(etor, thread_count, 50, problem);
+		best += std::get<0>(result.get());
+		memory = static_cast<double>(result.stats().memory_bytes) / (1 << 20);
+	}
+	state.counters["best"] = benchmark::Counter(best, benchmark::Counter::kAvgIterations);
+	state.counters["memory_MiB"] = memory;
+	// 40 particles, 1000 iterations
+	state.counters["particle_iterations/s"] = benchmark::Counter(40.0 * 1000, benchmark::Counter::kIsIterationInvariantRate);
+}
+//BENCHMARK_TEMPLATE(benchmark_precision, double)
+//->Unit(benchmark::kMillisecond)->Iterations(1)->Repetitions(3)
+//->ArgsProduct({ { 0, 1, 2, 3, 4, 5, 6 }, { 30, 10000 }, { 4 } });
+//BENCHMARK_TEMPLATE(benchmark_precision, float)
+//->Unit(benchmark::kMillisecond)->Iterations(1)->Repetitions(3)
+//->ArgsProduct({ { 0, 1, 2, 3, 4, 5, 6 }, { 30, 10000 }, { 4 } });
+
+// Evaluations saved by the surrogate vs. final quality
+// Args: [function idx] [surrogate on/off] [thread_count]
+static void benchmark_surrogate(benchmark::State& state) {
+	using papso_t = basic_papso<hungbiu::spmc_buffer<vec_t>, 2, 40, 1000>;
+	const auto idx = state.range(0);
+	const optimization_problem_t problem{
+		test_functions::functions[idx]
+		, test_functions::bounds[idx]
+		, test_functions::dimensions[idx]
+	};
+
+	knn_surrogate surrogate{ test_functions::dimensions[idx] };
+	papso_options options;
+	options.surrogate = state.range(1) ? &surrogate : nullptr;
+
+	const size_t thread_count = static_cast<size_t>(state.range(2));
+	hungbiu::hb_executor etor(thread_count);
+	double best = 0, skips = 0;
+	for (auto _ : state) {
+		surrogate.clear();
+		auto result = papso_t::parallel_async_pso(etor, thread_count, 100, problem, options);
+		best += std::get<0>(result.get());
+		skips += result.stats().surrogate_skips;
+	}
+	state.counters["best"] = benchmark::Counter(best, benchmark::Counter::kAvgIterations);
+	// Of 40 particles over 1000 iterations
+	state.counters["saved"] = benchmark::Counter(skips / (40. * 1000), benchmark::Counter::kAvgIterations);
+}
+//BENCHMARK(benchmark_surrogate)
+//->Unit(benchmark::kMillisecond)->Iterations(5)
+//->ArgsProduct({ { 0, 1, 2, 3, 4, 5, 6 }, { 0, 1 }, { 4 } });
+
+// One ring over all subswarms vs. islands exchanging their best every few iterations
+// Args: [function idx] [migration_interval] [migrants] [thread_count]
+static void benchmark_islands(benchmark::State& state) {
+	using papso_t = basic_papso<hungbiu::spmc_buffer<vec_t>, 2, 160, 2000>;
+	const auto idx = state.range(0);
+	const optimization_problem_t problem{
+		test_functions::functions[idx]
+		, test_functions::bounds[idx]
+		, test_functions::dimensions[idx]
+	};
+	papso_options options;
+	options.migration_interval = static_cast<size_t>(state.range(1));
+	options.migrants = static_cast<size_t>(state.range(2));
+
+	const size_t thread_count = static_cast<size_t>(state.range(3));
+	hungbiu::hb_executor etor(thread_count);
+	double best = 0, immigrants = 0;
+	for (auto _ : state) {
+		auto result = papso_t::parallel_async_pso(etor, 2 * thread_count, 100, problem, options);
+		best += std::get<0>(result.get());
+		immigrants += result.stats().immigrants;
+	}
+	state.counters["best"] = benchmark::Counter(best, benchmark::Counter::kAvgIterations);
+	state.counters["immigrants"] = benchmark::Counter(immigrants, benchmark::Counter::kAvgIterations);
+}
+//BENCHMARK(benchmark_islands)
+//->Unit(benchmark::kMillisecond)->Iterations(5)
+//->ArgsProduct({ { 3, 4 }, { 0 }, { 0 }, { 2, 4, 8, 16 } })
+//->ArgsProduct({ { 3, 4 }, { 25, 100 }, { 1, 4 }, { 2, 4, 8, 16 } });
+
+#if defined(__linux__)
+// The same islands spread over processes migrating through shared memory, each process
+// runs `islands` islands on a single thread. The best of all processes is reported
+// Args: [function idx] [process_count] [islands]
+static void benchmark_shm_islands(benchmark::State& state) {
+	using papso_t = basic_papso<hungbiu::spmc_buffer<vec_t>, 2, 40, 2000>;
+	const auto idx = state.range(0);
+	const size_t process_count = static_cast<size_t>(state.range(1));
+	const size_t islands = static_cast<size_t>(state.range(2));
+	const char* name = "/benchmark_shm_islands";
+	auto* bests = static_cast<double*>(mmap(nullptr, process_count * sizeof(double)
+		, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+
+	double best = 0;
+	for (auto _ : state) {
+		shm_migration::remove(name);
+		for (size_t p = 0; p < process_count; ++p) {
+			if (0 == fork()) {
+				shm_migration channel(name, p, process_count, test_functions::dimensions[idx]);
+				const optimization_problem_t problem{
+					test_functions::functions[idx]
+					, test_functions::bounds[idx]
+					, test_functions::dimensions[idx]
+				};
+				papso_options options;
+				options.migration_interval = 50;
+				options.channel = &channel;
+				hungbiu::hb_executor etor(1);
+				auto result = papso_t::parallel_async_pso(etor, islands, 100, problem, options);
+				bests[p] = std::get<0>(result.get());
+				_exit(0);
+			}
+		}
+		for (size_t p = 0; p < process_count; ++p) {
+			wait(nullptr);
+		}
+		best += *std::min_element(bests, bests + process_count);
+	}
+	shm_migration::remove(name);
+	munmap(bests, process_count * sizeof(double));
+	state.counters["best"] = benchmark::Counter(best, benchmark::Counter::kAvgIterations);
+	state.counters["islands/s"] = benchmark::Counter(static_cast<double>(process_count * islands), benchmark::Counter::kIsIterationInvariantRate);
+}
+//BENCHMARK(benchmark_shm_islands)
+//->Unit(benchmark::kMillisecond)->Iterations(3)
+//->ArgsProduct({ { 3, 4 }, { 1, 2, 4, 8 }, { 4 } });
+#endif
+
+// Cost of checkpointing, a fresh file every run so that none resumes
+// Args: [checkpoint_interval_ms, -1 for none] [thread_count]
+static void benchmark_checkpoint(benchmark::State& state) {
+	const char* path = "benchmark_checkpoint.bin";
+	const optimization_problem_t problem = scaled_rosenbrock<50>::problem;
+	papso_options options;
+	if (state.range(0) >= 0) {
+		options.checkpoint_path = path;
+		options.checkpoint_interval = std::chrono::milliseconds{ state.range(0) };
+	}
+
+	const size_t thread_count = static_cast<size_t>(state.range(1));
+	hungbiu::hb_executor etor(thread_count);
+	size_t checkpoints = 0;
+	for (auto _ : state) {
+		state.PauseTiming();
+		std::remove(path);
+		state.ResumeTiming();
+		auto result = papso::parallel_async_pso(etor, thread_count, 100, problem, options);
+		benchmark::DoNotOptimize(result.get());
+		checkpoints += result.stats().checkpoints;
+	}
+	std::remove(path);
+	state.counters["checkpoints"] = benchmark::Counter(static_cast<double>(checkpoints), benchmark::Counter::kAvgIterations);
+}
+//BENCHMARK(benchmark_checkpoint)
+//->Unit(benchmark::kMillisecond)->Iterations(3)
+//->ArgsProduct({ { -1, 1000, 100, 10 }, { 4 } });
+
+// Best value of a short run, started cold or warm from the archive of the runs before it
+// Args: [warm] [thread_count]
+static void benchmark_warm_start(benchmark::State& state) {
+	using short_papso = basic_papso<hungbiu::spmc_buffer<vec_t>, 2, 40, 200>;
+	const char* path = "benchmark_warm_start.bin";
+	const optimization_problem_t problem{ test_functions::functions[4], test_functions::bounds[4], 30 };
+
+	const size_t thread_count = static_cast<size_t>(state.range(1));
+	hungbiu::hb_executor etor(thread_count);
+	double best = 0;
+	std::remove(path);
+	{
+		solution_archive archive(path); // Saved on destruction, before the file is removed
+		papso_options options;
+		if (state.range(0)) {
+			options.archive = &archive;
+			options.problem_id = "rastrigin30";
+		}
+		for (auto _ : state) {
+			auto result = short_papso::parallel_async_pso(etor, thread_count, 20, problem, options);
+			best += std::get<0>(result.get());
+		}
+	}
+	std::remove(path);
+	state.counters["best"] = benchmark::Counter(best, benchmark::Counter::kAvgIterations);
+}
+//BENCHMARK(benchmark_warm_start)
+//->Unit(benchmark::kMillisecond)->Iterations(10)
+//->ArgsProduct({ { 0, 1 }, { 4 } });
+
+// Throughput of the deterministic mode, a barrier every iteration, against free-running forks
+// Args: [deterministic] [thread_count]
+static void benchmark_deterministic(benchmark::State& state) {
+	const optimization_problem_t problem = scaled_rosenbrock<50>::problem;
+	papso_options options;
+	options.deterministic = state.range(0);
+	options.seed = 42;
+
+	const size_t thread_count = static_cast<size_t>(state.range(1));
+	hungbiu::hb_executor etor(thread_count);
+	for (auto _ : state) {
+		auto result = papso::parallel_async_pso(etor, thread_count, 100, problem, options);
+		benchmark::DoNotOptimize(result.get());
+	}
+	// 40 particles, 5000 iterations
+	state.counters["evaluations/s"] = benchmark::Counter(40.0 * 5000, benchmark::Counter::kIsIterationInvariantRate);
+}
+//BENCHMARK(benchmark_deterministic)
+//->Unit(benchmark::kMillisecond)->Iterations(3)
+//->ArgsProduct({ { 0, 1 }, { 1, 2, 4, 8 } });
+
+// Time until the best value is at most 100, generational against asynchronous,
+// the objective costs `Scale` Rosenbrock evaluations
+// Args: [synchronous] [thread_count]
+template <size_t Scale>
+static void benchmark_time_to_target(benchmark::State& state) {
+	const optimization_problem_t problem = scaled_rosenbrock<Scale>::problem;
+	papso_options options;
+	options.synchronous = state.range(0);
+	options.target_value = 100;
+
+	const size_t thread_count = static_cast<size_t>(state.range(1));
+	hungbiu::hb_executor etor(thread_count);
+	double ms = 0, reached = 0, iterations = 0;
+	for (auto _ : state) {
+		auto result = papso::parallel_async_pso(etor, thread_count, 100, problem, options);
+		benchmark::DoNotOptimize(result.get());
+		const papso_stats& stats = result.stats();
+		if (stats.reached_target) {
+			ms += std::chrono::duration<double, std::milli>(stats.time_to_target).count();
+			iterations += stats.iterations_to_target;
+			reached++;
+		}
+	}
+	state.counters["ms_to_target"] = benchmark::Counter(reached ? ms / reached : 0);
+	state.counters["iterations_to_target"] = benchmark::Counter(reached ? iterations / reached : 0);
+	state.counters["reached"] = benchmark::Counter(reached, benchmark::Counter::kAvgIterations);
+}
+//BENCHMARK_TEMPLATE(benchmark_time_to_target, 1)
+//->Unit(benchmark::kMillisecond)->Iterations(5)
+//->ArgsProduct({ { 0, 1 }, { 1, 2, 4, 8 } });
+//BENCHMARK_TEMPLATE(benchmark_time_to_target, 50)
+//->Unit(benchmark::kMillisecond)->Iterations(5)
+//->ArgsProduct({ { 0, 1 }, { 1, 2, 4, 8 } });
+
+// Best value for a fixed number of evaluations, drawn in quotas of `evaluation_quota`
+// Args: [max_evaluations] [evaluation_quota] [thread_count]
+static void benchmark_evaluation_budget(benchmark::State& state) {
+	const optimization_problem_t problem = scaled_rosenbrock<50>::problem;
+	papso_options options;
+	options.max_evaluations = static_cast<size_t>(state.range(0));
+	options.evaluation_quota = static_cast<size_t>(state.range(1));
+
+	const size_t thread_count = static_cast<size_t>(state.range(2));
+	hungbiu::hb_executor etor(thread_count);
+	double best = 0, evaluations = 0;
+	for (auto _ : state) {
+		auto result = papso::parallel_async_pso(etor, thread_count, 100, problem, options);
+		best += std::get<0>(result.get());
+		evaluations += result.stats().evaluations;
+	}
+	state.counters["best"] = benchmark::Counter(best, benchmark::Counter::kAvgIterations);
+	state.counters["evaluations"] = benchmark::Counter(evaluations, benchmark::Counter::kAvgIterations);
+}
+//BENCHMARK(benchmark_evaluation_budget)
+//->Unit(benchmark::kMillisecond)->Iterations(5)
+//->ArgsProduct({ { 10000, 100000 }, { 1, 32, 256 }, { 3, 4, 8 } });
+
+// Many tiny problems (dimension 2 to 10, swarm 20) solved as one batch or one run each,
+// the same ring of 3 and the same number of iterations either way
+// Args: [batched] [problem count] [problems_per_task] [thread_count]
+static void benchmark_batch(benchmark::State& state) {
+	using tiny_papso = basic_papso<hungbiu::spmc_buffer<vec_t>, 2, 20, 100>;
+	using tiny_batch = basic_batch_pso<2, 20, 100>;
+
+	std::vector<optimization_problem_t> problems;
+	for (int64_t i = 0; i < state.range(1); ++i) {
+		const auto idx = i % 7;
+		problems.push_back({ test_functions::functions[idx], test_functions::bounds[idx], static_cast<size_t>(2 + i % 9) });
+	}
+
+	const size_t thread_count = static_cast<size_t>(state.range(3));
+	hungbiu::hb_executor etor(thread_count);
+	for (auto _ : state) {
+		if (state.range(0)) {
+			auto result = tiny_batch::parallel_batch_pso(etor, problems, static_cast<size_t>(state.range(2)));
+			benchmark::DoNotOptimize(result.get());
+			continue;
+		}
+		for (const auto& problem : problems) {
+			auto result = tiny_papso::parallel_async_pso(etor, 1, 100, problem);
+			benchmark::DoNotOptimize(result.get());
+		}
+	}
+	state.counters["problems/s"] = benchmark::Counter(static_cast<double>(problems.size()), benchmark::Counter::kIsIterationInvariantRate);
+}
+//BENCHMARK(benchmark_batch)
+//->Unit(benchmark::kMillisecond)
+//->Args({ 0, 10000, 0, 4 })
+//->Args({ 1, 10000, 16, 4 })
+//->Args({ 1, 10000, 256, 4 });
+
+// Short runs submitted while a long one occupies the executor, in jobs of their own or all in the default job
+// Args: [separate jobs] [long run weight] [thread_count]
+static void benchmark_job_fairness(benchmark::State& state) {
+	using short_papso = basic_papso<hungbiu::spmc_buffer<vec_t>, 2, 40, 200>;
+	const optimization_problem_t problem{
+		test_functions::functions[4]
+		, test_functions::bounds[4]
+		, test_functions::dimensions[4]
+	};
+	const bool separate = state.range(0);
+
+	const size_t thread_count = static_cast<size_t>(state.range(2));
+	hungbiu::hb_executor etor(thread_count);
+	std::vector<double> latencies;
+	for (auto _ : state) {
+		papso_options long_options, short_options;
+		if (separate) {
+			long_options.job = etor.create_job(static_cast<double>(state.range(1))).value();
+			short_options.job = etor.create_job().value();
+		}
+		auto long_run = papso::parallel_async_pso(etor, 4 * thread_count, 50, problem, long_options);
+		for (int i = 0; i < 20; ++i) {
+			const auto start = std::chrono::steady_clock::now();
+			auto result = short_papso::parallel_async_pso(etor, thread_count, 50, problem, short_options);
+			benchmark::DoNotOptimize(result.get());
+			latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		benchmark::DoNotOptimize(long_run.get());
+		etor.release_job(long_options.job);
+		etor.release_job(short_options.job);
+	}
+	std::sort(latencies.begin(), latencies.end());
+	state.counters["p50 ms"] = latencies[latencies.size() / 2];
+	state.counters["p99 ms"] = latencies[latencies.size() * 99 / 100];
+}
+//BENCHMARK(benchmark_job_fairness)
+//->Unit(benchmark::kMillisecond)->Iterations(3)
+//->Args({ 0, 1, 4 })
+//->Args({ 1, 1, 4 })
+//->Args({ 1, 4, 4 });
+
+#if defined(__linux__)
+// Same test function in process vs. through a pool of worker processes
+// Args: [function idx] [process_count] [thread_count]
+template <bool Pooled>
+static void benchmark_process_objective(benchmark::State& state) {
+	const auto idx = state.range(0);
+	const auto f = test_functions::functions[idx];
+	const size_t dim = test_functions::dimensions[idx];
+
+	// Workers fork before the executor starts its threads
+	std::unique_ptr<process_pool_objective> pool;
+	if (Pooled) {
+		pool = std::make_unique<process_pool_objective>(f, dim, static_cast<size_t>(state.range(1)));
+	}
+	const optimization_problem_t problem{ f, test_functions::bounds[idx], dim, pool.get() };
+	papso_options options;
+	options.evaluations_in_flight = 8;
+
+	const size_t thread_count = static_cast<size_t>(state.range(2));
+	hungbiu::hb_executor etor(thread_count);
+	for (auto _ : state) {
+		auto result = papso::parallel_async_pso(etor, thread_count, 500, problem, options);
+		benchmark::DoNotOptimize(result.get());
+	}
+	// 40 particles, 5000 iterations
+	state.counters["evaluations/s"] = benchmark::Counter(40.0 * 5000, benchmark::Counter::kIsIterationInvariantRate);
+}
+//BENCHMARK_TEMPLATE(benchmark_process_objective, false)
+//->Unit(benchmark::kMillisecond)->Iterations(1)->Repetitions(3)
+//->Args({ 4, 0, 4 });
+//BENCHMARK_TEMPLATE(benchmark_process_objective, true)
+//->Unit(benchmark::kMillisecond)->Iterations(1)->Repetitions(3)
+//->Args({ 4, 2, 4 })
+//->Args({ 4, 4, 4 });
+#endif
+
 // Args: [function idx] [dimensions] [iterations]
 static void benchmark_test_functions(benchmark::State& state) {
 	const auto idx = state.range(0);
@@ -0,0 +1,208 @@
+/*
+* Many small independent problems in one call
+* Problems are split into coarse tasks solving theirs one after the other, every task
+* owns a slice of one contiguous arena that holds the swarm of the problem it is on.
+* Each problem runs the lbest ring of `basic_papso` as a single subswarm, the same
+* update rule and generator. Results are written in bulk, there is a single wait for the whole batch.
+*/
+#ifndef _BATCH_PAPSO
+#define _BATCH_PAPSO
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+#include "papso2.h"
+
+template <size_t neighbor_size, size_t swarm_size, size_t iteration>
+class basic_batch_pso {
+public:
+	using size_t = std::size_t;
+	using range_t = std::pair<size_t, size_t>;
+	using worker_handle = hungbiu::hb_executor::worker_handle;
+
+	// Best value and position of every problem, positions back to back
+	struct batch_solution_t {
+		std::vector<double> values;
+		vec_t positions;
+		std::vector<size_t> offsets; // Of each problem's position in `positions`
+
+		std::span<const double> position(size_t i) const noexcept {
+			return { positions.data() + offsets[i], positions.data() + offsets[i + 1] };
+		}
+	};
+
+private:
+	static constexpr size_t line = 64 / sizeof(double); // Slices start on their own cache line
+
+	friend class latch_tracer<basic_batch_pso>;
+	using fork_tracer = latch_tracer<basic_batch_pso>;
+
+	std::vector<optimization_problem_t> problems;
+	std::vector<range_t> task_ranges; // Problems of every task
+	std::vector<size_t> slices; // Offset of every task's slice in `arena`
+	vec_t arena; // Velocity, position, best position of each particle, then pbest values
+	batch_solution_t solution;
+
+	fork_latch latch;
+
+	void complete() noexcept {
+		latch.notify();
+	}
+
+	static size_t footprint(size_t dimension) noexcept {
+		return swarm_size * (3 * dimension + 1);
+	}
+
+	basic_batch_pso(std::span<const optimization_problem_t> batch, size_t problems_per_task)
+		: problems(batch.begin(), batch.end())
+	{
+		const size_t n = problems.size();
+		problems_per_task = std::max<size_t>(problems_per_task, 1);
+
+		solution.values.resize(n);
+		solution.offsets.resize(n + 1);
+		for (size_t i = 0; i < n; ++i) {
+			solution.offsets[i + 1] = solution.offsets[i] + problems[i].dimension;
+		}
+		solution.positions.resize(solution.offsets[n]);
+
+		// A slice fits the largest swarm of its task
+		slices.push_back(0);
+		for (size_t first = 0; first < n; first += problems_per_task) {
+			const range_t range{ first, std::min(first + problems_per_task, n) };
+			size_t largest = 0;
+			for (size_t i = range.first; i < range.second; ++i) {
+				largest = std::max(largest, footprint(problems[i].dimension));
+			}
+			task_ranges.push_back(range);
+			slices.push_back(slices.back() + (largest + line - 1) / line * line);
+		}
+		arena.resize(slices.back());
+	}
+
+	// Lowest pbest among particle i and its `neighbor_size / 2` neighbours on either side
+	static size_t lbest(const double* best_values, size_t i) noexcept {
+		static constexpr int max_offset = neighbor_size / 2;
+		size_t best = i;
+		for (int offset = -max_offset; offset <= max_offset; ++offset) {
+			const size_t neighbor = (i + swarm_size + offset) % swarm_size;
+			if (best_values[neighbor] < best_values[best]) {
+				best = neighbor;
+			}
+		}
+		return best;
+	}
+
+	void solve(size_t p, double* swarm, const canonical_rng& rng) {
+		static constexpr double INERTIA = 0.7298;
+		static constexpr double ACCELERATOR = 1.49618;
+
+		const optimization_problem_t& problem = problems[p];
+		const size_t dim = problem.dimension;
+		const double min = problem.feasible_bound.first, max = problem.feasible_bound.second;
+		const func_t f = problem.function;
+		auto velocity = [&](size_t i) { return swarm + i * 3 * dim; };
+		auto position = [&](size_t i) { return velocity(i) + dim; };
+		auto best_position = [&](size_t i) { return velocity(i) + 2 * dim; };
+		auto evaluate = [&](const double* x) {
+			// `func_t` takes vector iterators, the arena is a vector too
+			const auto first = arena.cbegin() + (x - arena.data());
+			return f(first, first + dim);
+		};
+		double* const best_values = swarm + swarm_size * 3 * dim;
+
+		auto random_xi = [&]() {
+			return min + rng() * (max - min);
+		};
+		for (size_t i = 0; i < swarm_size; ++i) {
+			auto v = velocity(i), x = position(i), px = best_position(i);
+			for (size_t d = 0; d < dim; ++d) {
+				x[d] = random_xi();
+				px[d] = x[d];
+				v[d] = (random_xi() - x[d]) / 2.0;
+			}
+			best_values[i] = evaluate(x);
+		}
+
+		for (size_t it = 0; it < iteration; ++it) {
+			for (size_t i = 0; i < swarm_size; ++i) {
+				auto v = velocity(i), x = position(i), px = best_position(i);
+				const auto gx = best_position(lbest(best_values, i));
+				for (size_t d = 0; d < dim; ++d) {
+					v[d] = INERTIA * v[d]
+						+ ACCELERATOR * rng() * (px[d] - x[d])
+						+ ACCELERATOR * rng() * (gx[d] - x[d]);
+					x[d] += v[d];
+
+					// Confinement
+					if (x[d] < min) {
+						x[d] = min;
+						v[d] = 0;
+					}
+					else if (x[d] > max) {
+						x[d] = max;
+						v[d] = 0;
+					}
+				}
+
+				const double value = evaluate(x);
+				if (value < best_values[i]) {
+					best_values[i] = value;
+					std::copy_n(x, dim, px);
+				}
+			}
+		}
+
+		const size_t best = std::min_element(best_values, best_values + swarm_size) - best_values;
+		solution.values[p] = best_values[best];
+		std::copy_n(best_position(best), dim, solution.positions.begin() + solution.offsets[p]);
+	}
+
+	auto fork(size_t t) {
+		return [this, tracer = fork_tracer(this), t](worker_handle&) {
+			const canonical_rng rng;
+			for (size_t p = task_ranges[t].first; p < task_ranges[t].second; ++p) {
+				solve(p, arena.data() + slices[t], rng);
+			}
+		};
+	}
+
+public:
+	class batch_result_t {
+		std::unique_ptr<basic_batch_pso> state_;
+	public:
+		batch_result_t(std::unique_ptr<basic_batch_pso> state)
+			: state_(std::move(state)) {}
+
+		// Block until every problem is solved
+		batch_solution_t get() {
+			auto& state = *state_;
+			state.latch.wait();
+			batch_solution_t solution = std::move(state.solution);
+			state_.reset();
+			return solution;
+		}
+	};
+
+	// One task per `problems_per_task` problems, a ring of `swarm_size` particles each
+	// Asynchronous and separable objectives are not used here, `function` always is
+	static batch_result_t parallel_batch_pso(hungbiu::hb_executor& etor
+		, std::span<const optimization_problem_t> batch, size_t problems_per_task
+		, hungbiu::hb_executor::job_id job = hungbiu::hb_executor::default_job) {
+		auto state_uptr = std::unique_ptr<basic_batch_pso>(new basic_batch_pso(batch, problems_per_task));
+		auto& state = *state_uptr;
+		{
+			fork_tracer launching(&state); // Until every task is out
+			for (size_t t = 0; t < state.task_ranges.size(); ++t) {
+				etor.execute(job, state.fork(t));
+			}
+		}
+		return batch_result_t{ std::move(state_uptr) };
+	}
+};
+
+using batch_papso = basic_batch_pso<2, 20, 1000>;
+
+#endif
@@ -8,6 +8,9 @@
 #include <memory>
 #include <new>
 #include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 class canonical_rng
 {	
 	struct alignas(64) storage {
@@ -23,11 +26,31 @@ class canonical_rng
 	std::unique_ptr<storage> storage_ptr_;
 	
 public:
+	static constexpr std::size_t storage_size = sizeof(storage);
+
 	canonical_rng() : storage_ptr_(std::make_unique<storage>()) {}
 	canonical_rng(canonical_rng&& oth) noexcept
 		: storage_ptr_(std::move(oth.storage_ptr_)) {}
 	~canonical_rng() {}
 
+	// Restart from a known state, `stream` tells apart generators of the same seed
+	void seed(std::uint64_t seed, std::uint64_t stream) {
+		std::seed_seq seq{
+			static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)
+			, static_cast<std::uint32_t>(stream), static_cast<std::uint32_t>(stream >> 32) };
+		storage_ptr_->generator_.seed(seq);
+		storage_ptr_->real_distribute.reset();
+	}
+
+	// Raw engine state, `storage_size` bytes
+	void save(void* out) const noexcept {
+		static_assert(std::is_trivially_copyable_v<storage>, "engine state must be copyable as bytes");
+		std::memcpy(out, storage_ptr_.get(), sizeof(storage));
+	}
+	void load(const void* in) noexcept {
+		std::memcpy(storage_ptr_.get(), in, sizeof(storage));
+	}
+
 	inline double operator()() const {
 		auto& s = *storage_ptr_;
 		return s.real_distribute(s.generator_);
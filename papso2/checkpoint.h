@@ -0,0 +1,184 @@
+/*
+* Snapshot file of a swarm, one section per fork
+* A header, a directory of which slot each fork last completed, then two slots per
+* fork: a fork always writes the slot not in the directory and flips the entry after,
+* so the directory never points at a half written slot. Slots are raw and fixed
+* size, the file maps straight back into memory to resume.
+* Mapped on Linux, elsewhere an in-memory image rewritten to the file on `flush`.
+*/
+#ifndef _CHECKPOINT
+#define _CHECKPOINT
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <system_error>
+#if defined(__linux__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#endif
+
+class swarm_checkpoint {
+public:
+	// Shape of the run, a file of another shape is not resumed
+	struct shape_t {
+		std::uint64_t dimension = 0;
+		std::uint64_t swarm_size = 0;
+		std::uint64_t fork_count = 0;
+		std::uint64_t real_size = 0; // sizeof(real_t)
+		std::uint64_t slot_size = 0; // Bytes of one fork slot
+
+		bool operator==(const shape_t&) const = default;
+	};
+
+	// Fixed part of a fork slot, its particles follow
+	struct alignas(64) fork_header {
+		std::uint64_t iteration; // Completed
+		std::uint64_t first, last; // Subswarm
+	};
+
+private:
+	static constexpr char magic[8] = { 'P', 'A', 'P', 'S', 'O', 'C', 'K', '1' };
+
+	struct alignas(64) file_header {
+		char magic[8];
+		shape_t shape;
+	};
+	// Slot + 1 a fork last completed, zero before its first checkpoint
+	struct alignas(64) directory_entry {
+		std::atomic<std::uint32_t> active;
+	};
+
+	std::string path_;
+	shape_t shape_;
+	std::size_t size_ = 0;
+	std::byte* image_ = nullptr;
+	bool resumable_ = false;
+#if defined(__linux__)
+	int fd_ = -1;
+#else
+	std::unique_ptr<std::byte[]> buffer_;
+#endif
+
+	file_header& header() const noexcept {
+		return *reinterpret_cast<file_header*>(image_);
+	}
+	directory_entry& entry(std::size_t fork) const noexcept {
+		return reinterpret_cast<directory_entry*>(image_ + sizeof(file_header))[fork];
+	}
+	std::byte* slot(std::size_t fork, std::size_t s) const noexcept {
+		return image_ + sizeof(file_header) + shape_.fork_count * sizeof(directory_entry)
+			+ (2 * fork + s) * shape_.slot_size;
+	}
+
+	bool check_existing() const noexcept {
+		if (0 != std::memcmp(header().magic, magic, sizeof(magic)) || !(header().shape == shape_)) {
+			return false;
+		}
+		for (std::size_t f = 0; f < shape_.fork_count; ++f) {
+			if (0 == entry(f).active.load(std::memory_order_relaxed)) {
+				return false;
+			}
+		}
+		return true;
+	}
+	void format() noexcept {
+		std::memset(image_, 0, size_);
+		std::memcpy(header().magic, magic, sizeof(magic));
+		header().shape = shape_;
+	}
+
+public:
+	// Opens `path`, a file of the same shape with every fork written is resumed,
+	// anything else is overwritten
+	swarm_checkpoint(const char* path, const shape_t& shape)
+		: path_(path), shape_(shape)
+		, size_(sizeof(file_header) + shape.fork_count * sizeof(directory_entry) + 2 * shape.fork_count * shape.slot_size)
+	{
+#if defined(__linux__)
+		fd_ = open(path, O_RDWR | O_CREAT, 0644);
+		if (fd_ < 0) {
+			throw std::system_error(errno, std::generic_category(), "open");
+		}
+		struct stat st;
+		const bool same_size = 0 == fstat(fd_, &st) && static_cast<std::size_t>(st.st_size) == size_;
+		if (!same_size && ftruncate(fd_, static_cast<off_t>(size_)) < 0) {
+			const int err = errno;
+			close(fd_);
+			throw std::system_error(err, std::generic_category(), "ftruncate");
+		}
+		void* mapping = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+		if (MAP_FAILED == mapping) {
+			const int err = errno;
+			close(fd_);
+			throw std::system_error(err, std::generic_category(), "mmap");
+		}
+		image_ = static_cast<std::byte*>(mapping);
+		resumable_ = same_size && check_existing();
+#else
+		buffer_ = std::make_unique<std::byte[]>(size_);
+		image_ = buffer_.get();
+		std::ifstream in(path, std::ios::binary);
+		resumable_ = in && in.read(reinterpret_cast<char*>(image_), size_) && in.gcount() == static_cast<std::streamsize>(size_)
+			&& in.peek() == std::ifstream::traits_type::eof() && check_existing();
+#endif
+		if (!resumable_) {
+			format();
+		}
+	}
+	swarm_checkpoint(const swarm_checkpoint&) = delete;
+	~swarm_checkpoint() {
+#if defined(__linux__)
+		munmap(image_, size_);
+		close(fd_);
+#endif
+	}
+
+	const shape_t& shape() const noexcept { return shape_; }
+	// Whether the file held a complete snapshot of this shape when opened
+	bool resumable() const noexcept { return resumable_; }
+
+	// The fork's last completed slot, valid when resumable
+	const std::byte* active(std::size_t fork) const noexcept {
+		return slot(fork, entry(fork).active.load(std::memory_order_acquire) - 1);
+	}
+	// The slot a fork writes next, only by that fork
+	std::byte* inactive(std::size_t fork) const noexcept {
+		return slot(fork, 1 == entry(fork).active.load(std::memory_order_relaxed) ? 1 : 0);
+	}
+	// Publish what the fork wrote into its inactive slot
+	void commit(std::size_t fork) noexcept {
+		auto& a = entry(fork).active;
+		a.store(1 == a.load(std::memory_order_relaxed) ? 2 : 1, std::memory_order_release);
+	}
+
+	// Start writing back, does not wait for the disk
+	// Off Linux the image is written whole to a temporary file renamed over the checkpoint,
+	// a fork committing twice during the copy may leave its slot torn in that copy
+	void flush() {
+#if defined(__linux__)
+		msync(image_, size_, MS_ASYNC);
+#else
+		const std::string temporary = path_ + ".tmp";
+		{
+			std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+			out.write(reinterpret_cast<const char*>(image_), size_);
+			if (!out) {
+				return;
+			}
+		}
+		std::error_code ec;
+		std::filesystem::rename(temporary, path_, ec);
+#endif
+	}
+};
+
+#endif
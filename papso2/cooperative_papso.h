@@ -0,0 +1,260 @@
+/*
+* Cooperative PSO splitting the dimensions (CPSO-S)
+* Every block of dimensions has a swarm of its own on a task chain of its own.
+* Its particles are evaluated within a context vector made of the other blocks' bests,
+* which every block publishes through an `spmc_buffer` and pulls at each chunk.
+* Parallelism grows with the dimension rather than with the swarm size.
+*/
+#ifndef _COOPERATIVE_PAPSO
+#define _COOPERATIVE_PAPSO
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "papso2.h"
+
+template <typename buffer_t, size_t swarm_size, size_t iteration>
+class basic_cooperative_pso {
+public:
+	using size_t = std::size_t;
+	using range_t = std::pair<size_t, size_t>;
+	using worker_handle = hungbiu::hb_executor::worker_handle;
+
+private:
+	// One swarm over `dims`, touched by its own task chain only
+	struct alignas(64) my_block {
+		range_t dims;
+		vec_t arena; // Velocity, position, best position of every particle, `width()` each
+		std::vector<double> best_values;
+		size_t best = 0; // Particle holding the block's best
+		bool improved = true; // Since the last publish
+		vec_t context; // Whole position, the others' segments as of the last pull
+		bool scored = false; // Whether `best_values` are in `context`
+		double others_sum = 0; // Separable objectives: terms outside `dims`
+		canonical_rng rng;
+
+		size_t width() const noexcept { return dims.second - dims.first; }
+		vec_t::iterator velocity(size_t i) noexcept { return arena.begin() + i * 3 * width(); }
+		vec_t::iterator position(size_t i) noexcept { return velocity(i) + width(); }
+		vec_t::iterator best_position(size_t i) noexcept { return velocity(i) + 2 * width(); }
+	};
+	using block = my_block;
+
+	friend class latch_tracer<basic_cooperative_pso>;
+	using fork_tracer = latch_tracer<basic_cooperative_pso>;
+
+	func_t f;
+	separable_objective separable;
+	size_t dimension;
+	double min, max;
+	size_t iteration_per_task;
+	std::vector<block> blocks;
+	std::vector<buffer_t> segments; // Best segment of every block
+
+	fork_latch latch;
+
+	void complete() noexcept {
+		latch.notify();
+	}
+
+	basic_cooperative_pso(const optimization_problem_t& problem, size_t block_count, size_t iter_per_task)
+		: f(problem.function), separable(problem.separable), dimension(problem.dimension)
+		, min(problem.feasible_bound.first), max(problem.feasible_bound.second)
+		, iteration_per_task(iter_per_task), segments(block_count)
+	{
+		// Contiguous blocks, the last one takes the rest
+		const size_t width = dimension / block_count;
+		blocks.reserve(block_count);
+		for (size_t b = 0; b < block_count; ++b) {
+			block& blk = blocks.emplace_back();
+			blk.dims = { b * width, b + 1 == block_count ? dimension : (b + 1) * width };
+		}
+	}
+
+	// Random particles, the first one stands for the block until its first chunk
+	void initialize_block(size_t b) {
+		block& blk = blocks[b];
+		const size_t width = blk.width();
+		auto random_xi = [&]() {
+			return min + blk.rng() * (max - min);
+		};
+
+		blk.arena.resize(swarm_size * 3 * width);
+		blk.best_values.assign(swarm_size, std::numeric_limits<double>::max());
+		for (size_t i = 0; i < swarm_size; ++i) {
+			auto v = blk.velocity(i), x = blk.position(i), px = blk.best_position(i);
+			for (size_t d = 0; d < width; ++d) {
+				x[d] = random_xi();
+				px[d] = x[d];
+				v[d] = (random_xi() - x[d]) / 2.0;
+			}
+		}
+		blk.context.resize(dimension);
+		segments[b].put(blk.position(0), blk.position(0) + width);
+	}
+
+	// The objective with `segment` in place of the block's dimensions
+	double evaluate(block& blk, vec_t::const_iterator segment) const noexcept {
+		const size_t width = blk.width();
+		if (separable.term) {
+			double sum = blk.others_sum;
+			for (size_t d = 0; d < width; ++d) {
+				sum += separable.term(blk.dims.first + d, segment[d]);
+			}
+			return separable.finalize ? separable.finalize(sum, dimension) : sum;
+		}
+		std::copy_n(segment, width, blk.context.begin() + blk.dims.first);
+		return f(blk.context.cbegin(), blk.context.cend());
+	}
+
+	// Pull the others' bests, the pbests are re-evaluated only if the context changed
+	void pull_context(size_t b) {
+		block& blk = blocks[b];
+		bool changed = !blk.scored;
+		for (size_t o = 0; o < blocks.size(); ++o) {
+			if (o == b) {
+				continue;
+			}
+			auto viewer = segments[o].get();
+			const auto segment = blk.context.begin() + blocks[o].dims.first;
+			if (!std::equal(viewer->cbegin(), viewer->cend(), segment)) {
+				std::copy(viewer->cbegin(), viewer->cend(), segment);
+				changed = true;
+			}
+		}
+		if (!changed) {
+			return;
+		}
+		blk.scored = true;
+
+		if (separable.term) {
+			double sum = 0;
+			for (size_t d = 0; d < dimension; ++d) {
+				if (d < blk.dims.first || d >= blk.dims.second) {
+					sum += separable.term(d, blk.context[d]);
+				}
+			}
+			blk.others_sum = sum;
+		}
+
+		for (size_t i = 0; i < swarm_size; ++i) {
+			blk.best_values[i] = evaluate(blk, blk.best_position(i));
+		}
+		const size_t previous_best = blk.best;
+		blk.best = std::min_element(blk.best_values.begin(), blk.best_values.end()) - blk.best_values.begin();
+		blk.improved = blk.improved || previous_best != blk.best;
+	}
+
+	void iterations(size_t b, range_t iteration_range) {
+		static constexpr double INERTIA = 0.7298;
+		static constexpr double ACCELERATOR = 1.49618;
+
+		block& blk = blocks[b];
+		const size_t width = blk.width();
+		for (size_t it = iteration_range.first; it < iteration_range.second; ++it) {
+			for (size_t i = 0; i < swarm_size; ++i) {
+				auto v = blk.velocity(i), x = blk.position(i), px = blk.best_position(i);
+				const auto gx = blk.best_position(blk.best);
+				for (size_t d = 0; d < width; ++d) {
+					v[d] = INERTIA * v[d]
+						+ ACCELERATOR * blk.rng() * (px[d] - x[d])
+						+ ACCELERATOR * blk.rng() * (gx[d] - x[d]);
+					x[d] += v[d];
+
+					// Confinement
+					if (x[d] < min) {
+						x[d] = min;
+						v[d] = 0;
+					}
+					else if (x[d] > max) {
+						x[d] = max;
+						v[d] = 0;
+					}
+				}
+
+				const double value = evaluate(blk, x);
+				if (value < blk.best_values[i]) {
+					blk.best_values[i] = value;
+					std::copy_n(x, width, px);
+					if (value < blk.best_values[blk.best]) {
+						blk.best = i;
+						blk.improved = true;
+					}
+				}
+			}
+		}
+	}
+
+	auto fork(size_t b, range_t iteration_range) {
+		return [this, tracer = fork_tracer(this), b, iteration_range](worker_handle& wh) {
+			block_main_loop(b, iteration_range, wh);
+		};
+	}
+
+	void block_main_loop(size_t b, range_t iteration_range, worker_handle& wh) {
+		block& blk = blocks[b];
+		pull_context(b);
+		iterations(b, iteration_range);
+		if (blk.improved) {
+			const auto best = blk.best_position(blk.best);
+			segments[b].put(best, best + blk.width());
+			blk.improved = false;
+		}
+
+		if (iteration_range.second < iteration) {
+			wh.execute(fork(b, { iteration_range.second
+				, std::min(iteration_range.second + iteration_per_task, iteration) }));
+		}
+	}
+
+public:
+	class cooperative_result_t {
+		std::unique_ptr<basic_cooperative_pso> state_;
+	public:
+		cooperative_result_t(std::unique_ptr<basic_cooperative_pso> state)
+			: state_(std::move(state)) {}
+
+		// Block until finished, the result is the blocks' last published bests put together
+		std::tuple<double, vec_t> get() {
+			auto& state = *state_;
+			state.latch.wait();
+
+			vec_t best_position(state.dimension);
+			for (size_t b = 0; b < state.blocks.size(); ++b) {
+				auto viewer = state.segments[b].get();
+				std::copy(viewer->cbegin(), viewer->cend(), best_position.begin() + state.blocks[b].dims.first);
+			}
+			const double best_value = state.f(best_position.cbegin(), best_position.cend());
+			state_.reset();
+			return { best_value, std::move(best_position) };
+		}
+	};
+
+	// `block_count` blocks of dimensions, one task chain each, at most one per dimension
+	// Asynchronous objectives are not used here
+	static cooperative_result_t parallel_cooperative_pso(hungbiu::hb_executor& etor
+		, size_t block_count, size_t iter_per_task, const optimization_problem_t& problem) {
+		block_count = std::clamp<size_t>(block_count, 1, problem.dimension);
+		auto state_uptr = std::unique_ptr<basic_cooperative_pso>(
+			new basic_cooperative_pso(problem, block_count, iter_per_task));
+		auto& state = *state_uptr;
+
+		// Every segment is published before any block pulls
+		for (size_t b = 0; b < block_count; ++b) {
+			state.initialize_block(b);
+		}
+		{
+			fork_tracer launching(&state); // Until every chain is out
+			for (size_t b = 0; b < block_count; ++b) {
+				etor.execute(state.fork(b, { 0, std::min(iter_per_task, iteration) }));
+			}
+		}
+		return cooperative_result_t{ std::move(state_uptr) };
+	}
+};
+
+using cooperative_papso = basic_cooperative_pso<hungbiu::spmc_buffer<vec_t>, 40, 5000>;
+
+#endif
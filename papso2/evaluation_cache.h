@@ -0,0 +1,139 @@
+/*
+* Memo of objective values, shared by all forks of a run
+* Positions within `tolerance` of each other per dimension map to the same key
+* (grid cells of that width), a key is the 64-bit hash of the quantized position.
+* Set associative with CLOCK replacement, entries are guarded by a seqlock each:
+* readers never block and a writer skips an entry somebody else is writing.
+*/
+#ifndef _EVALUATION_CACHE
+#define _EVALUATION_CACHE
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+class evaluation_cache {
+	static constexpr std::size_t ways = 4;
+	static constexpr std::uint64_t empty_key = 0;
+
+	struct entry {
+		std::atomic<std::uint32_t> version{ 0 }; // Odd while written
+		std::atomic<std::uint32_t> referenced{ 0 };
+		std::atomic<std::uint64_t> key{ empty_key };
+		std::atomic<double> value{ 0 };
+	};
+
+	struct alignas(64) set {
+		entry entries[ways];
+		std::atomic<std::uint32_t> hand{ 0 };
+	};
+
+	std::unique_ptr<set[]> sets_;
+	std::size_t mask_;
+	double inverse_tolerance_;
+
+	static std::uint64_t mix(std::uint64_t h) noexcept {
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ull;
+		h ^= h >> 33;
+		return h;
+	}
+
+public:
+	// At least `capacity` entries, rounded up to whole sets of a power of two count
+	// A zero `tolerance` only matches bit-identical positions
+	evaluation_cache(std::size_t capacity, double tolerance)
+		: sets_(std::make_unique<set[]>(std::bit_ceil(std::max<std::size_t>(1, (capacity + ways - 1) / ways))))
+		, mask_(std::bit_ceil(std::max<std::size_t>(1, (capacity + ways - 1) / ways)) - 1)
+		, inverse_tolerance_(tolerance > 0 ? 1. / tolerance : 0) {}
+	evaluation_cache(const evaluation_cache&) = delete;
+
+	std::size_t capacity() const noexcept { return (mask_ + 1) * ways; }
+
+	// Single precision positions are widened first
+	template <typename T>
+	std::uint64_t key(const T* position, std::size_t dimension) const noexcept {
+		std::uint64_t h = 0x9e3779b97f4a7c15ull ^ dimension;
+		for (std::size_t i = 0; i < dimension; ++i) {
+			const double x = position[i];
+			const std::uint64_t cell = inverse_tolerance_ > 0
+				? static_cast<std::uint64_t>(std::llround(x * inverse_tolerance_))
+				: std::bit_cast<std::uint64_t>(x + 0.); // -0. and 0. alike
+			h = mix(h ^ cell) + i;
+		}
+		return empty_key == h ? 1 : h;
+	}
+
+	bool find(std::uint64_t key, double& value) const noexcept {
+		set& s = sets_[key & mask_];
+		for (entry& e : s.entries) {
+			const auto v = e.version.load(std::memory_order_acquire);
+			if (v & 1) {
+				continue;
+			}
+			const auto k = e.key.load(std::memory_order_relaxed);
+			const double val = e.value.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (k != key || e.version.load(std::memory_order_relaxed) != v) {
+				continue;
+			}
+			if (!e.referenced.load(std::memory_order_relaxed)) {
+				e.referenced.store(1, std::memory_order_relaxed);
+			}
+			value = val;
+			return true;
+		}
+		return false;
+	}
+
+	// Dropped when the victim is being written concurrently
+	void insert(std::uint64_t key, double value) noexcept {
+		set& s = sets_[key & mask_];
+
+		// CLOCK: the first way not referenced since the hand last passed
+		entry* victim = nullptr;
+		auto hand = s.hand.load(std::memory_order_relaxed);
+		for (std::size_t step = 0; step < 2 * ways; ++step, ++hand) {
+			entry& e = s.entries[hand % ways];
+			const auto k = e.key.load(std::memory_order_relaxed);
+			if (k == key) {
+				return; // Someone got here first
+			}
+			if (empty_key == k || !e.referenced.load(std::memory_order_relaxed)) {
+				victim = &e;
+				break;
+			}
+			e.referenced.store(0, std::memory_order_relaxed);
+		}
+		if (!victim) {
+			victim = &s.entries[hand % ways];
+		}
+		s.hand.store(hand + 1, std::memory_order_relaxed);
+
+		auto v = victim->version.load(std::memory_order_relaxed);
+		if ((v & 1) || !victim->version.compare_exchange_strong(v, v + 1, std::memory_order_acquire)) {
+			return;
+		}
+		std::atomic_thread_fence(std::memory_order_release);
+		victim->key.store(key, std::memory_order_relaxed);
+		victim->value.store(value, std::memory_order_relaxed);
+		victim->referenced.store(0, std::memory_order_relaxed);
+		victim->version.store(v + 2, std::memory_order_release);
+	}
+
+	void clear() noexcept {
+		for (std::size_t i = 0; i <= mask_; ++i) {
+			for (entry& e : sets_[i].entries) {
+				e.key.store(empty_key, std::memory_order_relaxed);
+				e.referenced.store(0, std::memory_order_relaxed);
+			}
+		}
+	}
+};
+
+#endif
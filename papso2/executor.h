@@ -1,7 +1,16 @@
 #ifndef _EXECUTOR
 #define _EXECUTOR
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <type_traits>
+#include <utility>
 #include <vector>
 #include <cstddef>
 #include <random>
@@ -30,6 +39,19 @@ namespace hungbiu
 		using future_t = std::future<T>;
 		class worker_handle; // Forward declaration
 
+		// Jobs share the workers by weight: a worker runs the job with the least
+		// CPU time per weight first. Tasks forked by a task stay in its job
+		using job_id = std::size_t;
+		static constexpr job_id default_job = 0;
+		static constexpr std::size_t max_jobs = 16;
+
+		struct job_stats {
+			std::chrono::nanoseconds cpu_time{ 0 }; // Running the job's own tasks
+			std::chrono::nanoseconds wall_time{ 0 }; // Since the job was created
+			std::size_t tasks = 0;
+			double cpu_share = 0; // Of the CPU time of all jobs alive
+		};
+
 	private:
 		// r_task_wrapper: provide aysnc result
 		template <typename R>
@@ -198,9 +220,9 @@ namespace hungbiu
 			{
 				while (!future_ready(fut)) {
 					task_wrapper tw{};
-					if (ptr_worker_->_pop(tw) ||
-						ptr_worker_->_steal(tw)) {
-						tw.run(*this);
+					job_id job = default_job;
+					if (ptr_worker_->_next(tw, job, true)) {
+						ptr_worker_->_run(tw, job, *this);
 					}
 				}
 				return fut.get();
@@ -241,7 +263,14 @@ namespace hungbiu
 
 			hb_executor* etor_;
 			std::size_t index_;
-			deque_t<task_wrapper> run_stack_;
+			std::array<deque_t<task_wrapper>, max_jobs> run_stacks_; // One per job
+			job_id current_job_ = default_job; // Of the running task
+			// Live jobs least served first, rebuilt when the set of live slots changes
+			// and otherwise re-sorted in place, a few swaps as their CPU times move
+			job_id order_[max_jobs] = { default_job };
+			std::size_t order_size_ = 1;
+			std::uint32_t order_slots_ = 1; // Live slots `order_` holds
+			std::int64_t nested_ns_ = 0; // Run by the running task while it waits
 			std::condition_variable_any cv_;
 			std::mutex mtx_; // use this mutex to wait for condition
 
@@ -256,19 +285,77 @@ namespace hungbiu
 			alignas(64) unsigned pending_{ 0 };
 			rng_t rng_;
 
-			// Push a forked task onto stack
+			// Push a forked task onto the stack of the running task's job
 			void _push(task_wrapper tw)
 			{
-				run_stack_.push_back(tw); // Notify one?
+				etor_->enqueued(current_job_);
+				run_stacks_[current_job_].push_back(tw); // Notify one?
 			}
 			// Pop a task from stack for the worker itself to execute
-			[[nodiscard]] bool _pop(task_wrapper& tw) noexcept
+			[[nodiscard]] bool _pop(task_wrapper& tw, job_id job) noexcept
 			{
-				return run_stack_.pop_back(tw);
+				if (!run_stacks_[job].pop_back(tw)) {
+					return false;
+				}
+				etor_->jobs_[job].queued.fetch_sub(1, std::memory_order_relaxed);
+				return true;
 			}
-			[[nodiscard]] bool _steal(task_wrapper& tw)
+			void _order() noexcept
 			{
-				return etor_->steal(tw, index_, &rng_);
+				const std::uint32_t live = etor_->live_jobs();
+				if (live != order_slots_) {
+					order_slots_ = live;
+					order_size_ = 0;
+					for (std::uint32_t slots = live; slots; slots &= slots - 1) {
+						order_[order_size_++] = static_cast<job_id>(std::countr_zero(slots));
+					}
+				}
+				if (order_size_ < 2) {
+					return;
+				}
+				std::uint64_t keys[max_jobs];
+				for (std::size_t i = 0; i < order_size_; ++i) {
+					const job_id j = order_[i];
+					const auto key = etor_->jobs_[j].vruntime.load(std::memory_order_relaxed);
+					std::size_t k = i;
+					for (; k > 0 && keys[k - 1] > key; --k) { // Mostly in place already
+						keys[k] = keys[k - 1];
+						order_[k] = order_[k - 1];
+					}
+					keys[k] = key;
+					order_[k] = j;
+				}
+			}
+			// Jobs with queued tasks least served first, a job's tasks are stolen
+			// before the own stack of a job served more is popped
+			[[nodiscard]] bool _next(task_wrapper& tw, job_id& job, bool enable_stealing)
+			{
+				_order();
+				for (std::size_t i = 0; i < order_size_; ++i) {
+					const job_id j = order_[i];
+					if (etor_->jobs_[j].queued.load(std::memory_order_relaxed) <= 0) {
+						continue;
+					}
+					if (_pop(tw, j)
+						|| (enable_stealing && etor_->steal(tw, index_, j))) {
+						job = j;
+						return true;
+					}
+				}
+				return false;
+			}
+			// Charge the job with the task's own time, not with what it ran while waiting
+			void _run(task_wrapper& tw, job_id job, worker_handle& h)
+			{
+				const job_id outer_job = std::exchange(current_job_, job);
+				const std::int64_t outer_nested = std::exchange(nested_ns_, 0);
+				const auto start = std::chrono::steady_clock::now();
+				tw.run(h);
+				const std::int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now() - start).count();
+				etor_->charge(job, std::max<std::int64_t>(0, elapsed - nested_ns_));
+				nested_ns_ = outer_nested + elapsed;
+				current_job_ = outer_job;
 			}
 		public:
 			//static constexpr auto RUN_QUEUE_SIZE = 256u;
@@ -278,7 +365,7 @@ namespace hungbiu
 			worker(worker&& oth) noexcept // Should not be used, only for vector
 				: etor_(std::exchange(oth.etor_, nullptr))
 				, index_(std::exchange(oth.index_, -1))
-				, run_stack_(std::move(oth.run_stack_))
+				, run_stacks_(std::move(oth.run_stacks_))
 				/*, state_(oth.state_)*/
 				, rng_(std::move(oth.rng_)) {}
 			worker& operator=(const worker&) = delete;
@@ -291,31 +378,29 @@ namespace hungbiu
 					// This task wrapper must be destroyed at the end of the loop
 					task_wrapper tw;
 
-					// get work from local stack 
-					if (_pop(tw)) {
-						tw.run(h);
+					// get work from local stack, steal from others otherwise
+					job_id job = default_job;
+					if (_next(tw, job, enable_stealing)) {
+						_run(tw, job, h);
 						continue;
 					}
 
-					// steal from others
-					if (enable_stealing) {
-						if (etor_->steal(tw, index_, &rng_)) {
-							tw.run(h);
-							continue;
-						}
-					}
-
 					// Give up time slice
 					std::this_thread::yield();
 				} // End of while loop
 			}
-			void assign(task_wrapper& tw)
+			void assign(task_wrapper& tw, job_id job)
 			{
-				run_stack_.push_front(tw);
+				etor_->enqueued(job);
+				run_stacks_[job].push_front(tw);
 			}
-			[[nodiscard]] bool try_steal(task_wrapper& tw) noexcept
+			[[nodiscard]] bool try_steal(task_wrapper& tw, job_id job) noexcept
 			{
-				return run_stack_.pop_front(tw);
+				if (!run_stacks_[job].pop_front(tw)) {
+					return false;
+				}
+				etor_->jobs_[job].queued.fetch_sub(1, std::memory_order_relaxed);
+				return true;
 			}
 			void notify_work() {
 				{
@@ -352,8 +437,24 @@ namespace hungbiu
 		// --------------------------------------------------------------------------------
 		// Data members of executor
 		// --------------------------------------------------------------------------------
+		struct alignas(64) job_state {
+			std::atomic<bool> active{ false };
+			double weight = 1;
+			std::chrono::steady_clock::time_point created;
+			std::atomic<std::uint64_t> vruntime{ 0 }; // CPU time over weight, ns
+			std::atomic<std::uint64_t> cpu_ns{ 0 };
+			std::atomic<std::size_t> tasks{ 0 };
+			std::atomic<std::ptrdiff_t> queued{ 0 }; // In all workers' stacks
+		};
+
 		mutable std::atomic<bool> is_done_{ false };
 		std::atomic<size_t> ticket_{ 0 };
+		std::array<job_state, max_jobs> jobs_;
+		std::mutex jobs_mtx_; // Creation and release
+		// A bit per slot
+		std::atomic<std::uint32_t> active_jobs_{ 1 }; // The default job is always there
+		std::atomic<std::uint32_t> draining_jobs_{ 0 }; // Released, their tasks not all run
+		static_assert(max_jobs <= 32);
 		std::vector<worker> workers_;
 		std::vector<std::jthread> threads_;
 
@@ -393,19 +494,19 @@ namespace hungbiu
 				return std::uniform_int_distribution<std::size_t>()(engine);
 			}
 		}
-		void dispatch(task_wrapper tw)
+		void dispatch(task_wrapper tw, job_id job)
 		{
 			auto idx = ticket_.load();
 			const auto sz = workers_.size();
-			workers_[idx % sz].assign(tw);
+			workers_[idx % sz].assign(tw, job);
 			workers_[idx % sz].notify_work();
 			ticket_.compare_exchange_strong(idx, idx + 1, std::memory_order_acq_rel);
 		} 
 		const bool enable_stealing_;
-		[[nodiscard]] bool steal(task_wrapper& tw, const std::size_t idx, rng_t* rng)
+		[[nodiscard]] bool steal(task_wrapper& tw, const std::size_t idx, job_id job)
 		{		
 			for (size_t i = idx + 1; i < idx + workers_.size(); ++i) {
-				if (workers_[i % workers_.size()].try_steal(tw)) {
+				if (workers_[i % workers_.size()].try_steal(tw, job)) {
 
 #ifdef COUNT_STEALING
 				steal_count_.fetch_add(1, std::memory_order_relaxed);
@@ -414,12 +515,56 @@ namespace hungbiu
 				}
 			}
 			return false;
-		}		
+		}
+
+		// Slots to schedule: active jobs, and released ones until their last task is taken
+		std::uint32_t live_jobs() noexcept
+		{
+			std::uint32_t draining = draining_jobs_.load(std::memory_order_relaxed);
+			for (std::uint32_t slots = draining; slots; slots &= slots - 1) {
+				const std::uint32_t bit = slots & (~slots + 1);
+				const job_state& js = jobs_[std::countr_zero(slots)];
+				if (js.queued.load(std::memory_order_relaxed) > 0) {
+					continue;
+				}
+				draining_jobs_.fetch_and(~bit, std::memory_order_seq_cst);
+				if (js.queued.load(std::memory_order_seq_cst) > 0) { // Forked into meanwhile
+					draining_jobs_.fetch_or(bit, std::memory_order_seq_cst);
+					continue;
+				}
+				draining &= ~bit;
+			}
+			return active_jobs_.load(std::memory_order_acquire) | draining;
+		}
+
+		// A task forked into a released job keeps its slot scheduled
+		void enqueued(job_id job) noexcept
+		{
+			job_state& js = jobs_[job];
+			js.queued.fetch_add(1, std::memory_order_seq_cst);
+			if (default_job != job && !js.active.load(std::memory_order_seq_cst)) {
+				mark_draining(job);
+			}
+		}
+		void mark_draining(job_id job) noexcept
+		{
+			draining_jobs_.fetch_or(std::uint32_t{ 1 } << job, std::memory_order_seq_cst);
+		}
+
+		void charge(job_id job, std::int64_t ns) noexcept
+		{
+			job_state& js = jobs_[job];
+			js.cpu_ns.fetch_add(static_cast<std::uint64_t>(ns), std::memory_order_relaxed);
+			js.vruntime.fetch_add(static_cast<std::uint64_t>(ns / js.weight), std::memory_order_relaxed);
+			js.tasks.fetch_add(1, std::memory_order_relaxed);
+		}
 			
 	public:				
 		hb_executor(size_t parallelism, bool enable_stelaing = true) :
 			enable_stealing_(enable_stelaing)
 		{
+			jobs_[default_job].active.store(true, std::memory_order_relaxed);
+			jobs_[default_job].created = std::chrono::steady_clock::now();
 			workers_.reserve(parallelism);
 			threads_.reserve(parallelism);
 			for (auto i = 0u; i < parallelism; ++i) {
@@ -447,7 +592,7 @@ namespace hungbiu
 			}
 			auto t = make_task<F, R>(std::forward<F>(func));
 			auto fut = t.get_future();
-			dispatch( std::move(t) );
+			dispatch( std::move(t), default_job );
 			return fut;
 		}
 		
@@ -455,9 +600,76 @@ namespace hungbiu
 		template <typename F>
 		requires std::invocable<F, hb_executor::worker_handle&>
 		void execute(F&& func)
+		{
+			execute(default_job, std::forward<F>(func));
+		}
+		template <typename F>
+		requires std::invocable<F, hb_executor::worker_handle&>
+		void execute(job_id job, F&& func)
 		{
 			if (is_done()) { return; }
-			dispatch( std::forward<F>(func) );
+			dispatch( std::forward<F>(func), job );
+		}
+
+		// A job starts level with the least served one so that it does not monopolize the workers
+		// None when every slot is taken, `max_jobs` counts the default job
+		std::optional<job_id> create_job(double weight = 1.)
+		{
+			std::lock_guard guard{ jobs_mtx_ };
+			std::uint64_t start = std::numeric_limits<std::uint64_t>::max();
+			for (const job_state& js : jobs_) {
+				if (js.active.load(std::memory_order_relaxed)) {
+					start = std::min(start, js.vruntime.load(std::memory_order_relaxed));
+				}
+			}
+			for (job_id j = default_job + 1; j < max_jobs; ++j) {
+				job_state& js = jobs_[j];
+				if (js.active.load(std::memory_order_relaxed)
+					|| js.queued.load(std::memory_order_relaxed) > 0) {
+					continue;
+				}
+				js.weight = weight > 0 ? weight : 1.;
+				js.created = std::chrono::steady_clock::now();
+				js.vruntime.store(start, std::memory_order_relaxed);
+				js.cpu_ns.store(0, std::memory_order_relaxed);
+				js.tasks.store(0, std::memory_order_relaxed);
+				js.active.store(true, std::memory_order_release);
+				active_jobs_.fetch_or(std::uint32_t{ 1 } << j, std::memory_order_release);
+				return j;
+			}
+			return std::nullopt;
+		}
+		// Once its tasks are done, the slot is reused by a later job
+		// Tasks still queued are run all the same
+		void release_job(job_id job)
+		{
+			if (default_job == job) {
+				return;
+			}
+			std::lock_guard guard{ jobs_mtx_ };
+			job_state& js = jobs_[job];
+			if (js.active.exchange(false, std::memory_order_seq_cst)) {
+				if (js.queued.load(std::memory_order_seq_cst) > 0) {
+					mark_draining(job);
+				}
+				active_jobs_.fetch_and(~(std::uint32_t{ 1 } << job), std::memory_order_release);
+			}
+		}
+		job_stats stats(job_id job) const
+		{
+			const job_state& js = jobs_[job];
+			job_stats s;
+			s.cpu_time = std::chrono::nanoseconds{ static_cast<std::int64_t>(js.cpu_ns.load(std::memory_order_relaxed)) };
+			s.wall_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - js.created);
+			s.tasks = js.tasks.load(std::memory_order_relaxed);
+			std::uint64_t total = 0;
+			for (const job_state& other : jobs_) {
+				if (other.active.load(std::memory_order_relaxed)) {
+					total += other.cpu_ns.load(std::memory_order_relaxed);
+				}
+			}
+			s.cpu_share = total ? static_cast<double>(s.cpu_time.count()) / total : 0;
+			return s;
 		}
 	};
 
@@ -1,6 +1,8 @@
 // This is for profiling and demonstratin
 #define COUNT_STEALING
+#define PAPSO2_CHECK_SNAPSHOT // Synchronous runs only
 //#define PAPSO2_TRACK_CONVERGENCY
+//#define PAPSO2_PACKED_GBEST
 #include "papso2_test.h"
 #include <cstdio>
 
@@ -37,8 +39,14 @@ int main(int argc, const char* argv[]) {
 		: std::stoul(std::string{ argv[3] });
 
 	hungbiu::hb_executor etor(thread_count);
-	optimization_problem_t problem = scaled_rosenbrock<50>::problem;
 	using papso_t = basic_papso<hungbiu::spmc_buffer<vec_t>, 2, 100, 5000>;
+	if (!release_job_with_queued_forks_test(etor)
+		|| !job_slots_exhausted_test(etor)
+		|| !evaluation_budget_with_rebalance_test<papso_t>(etor, fork_count)
+		|| !synchronous_snapshot_test<basic_papso<hungbiu::spmc_buffer<vec_t>, 2, 40, 300>>(etor, fork_count)) {
+		return 1;
+	}
+	optimization_problem_t problem = scaled_rosenbrock<50>::problem;
 	parallel_async_pso_benchmark<papso_t>(etor, fork_count, iter_per_task, problem, test_functions::function_names[1]);
 	etor.done();
 }
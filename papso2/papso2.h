@@ -7,27 +7,229 @@
 #include <atomic>
 #include <memory>
 #include <numeric>
+#include <algorithm>
 #include <type_traits>
 #include <mutex>
-#include <condition_variable>
+#include <functional>
 #include <future>
+#include <optional>
+#include <thread>
+#include <limits>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <span>
+#include <string>
 #include "executor.h"
 #include "spmc_buffer.h"
 #include "canonical_rng.h"
+#include "swarm_memory.h"
+#include "evaluation_cache.h"
+#include "surrogate_model.h"
+#include "checkpoint.h"
+#include "solution_archive.h"
 
 using vec_t = std::vector<double>;
 using iter = vec_t::const_iterator;
 using func_t = double(*)(iter, iter);
 using bound_t = std::pair<double, double>;
 
+// Objective evaluated outside the calling thread (an external simulator, ...)
+// `submit` must not block on the evaluation,
+// the position stays untouched until the returned future is ready
+class async_objective {
+public:
+	virtual ~async_objective() {}
+	virtual std::future<double> submit(iter beg, iter end) = 0;
+	// Submissions may be held back until the caller is about to wait on them
+	virtual void flush() {}
+};
+
+// f(x) = finalize(sum of term(i, x[i]), dimension), finalize defaults to the plain sum
+struct separable_objective {
+	double(*term)(std::size_t, double) = nullptr;
+	double(*finalize)(double, std::size_t) = nullptr;
+};
+
+// Island migration with other processes, see shm_migration.h
+// Positions are `dimension` long
+class migration_channel {
+public:
+	virtual ~migration_channel() {}
+	virtual std::size_t migrants() const noexcept = 0;
+	// Offer our r-th best to the next process
+	virtual void emigrate(std::size_t r, const double* position, double value) noexcept = 0;
+	// The previous process's r-th best, only if its value is below `better_than`
+	// `position` is left untouched when false is returned
+	virtual bool immigrate(std::size_t r, double better_than, double* position, double& value) noexcept = 0;
+};
+
 struct optimization_problem_t {
 	const func_t function;
 	bound_t feasible_bound;
 	size_t dimension;
+	// Used instead of `function` when set
+	async_objective* async_function = nullptr;
+	// Same objective as `function`, evaluated incrementally when set, not with `async_function`
+	separable_objective separable = {};
+};
+
+// Runtime knobs of a run, the defaults behave as the plain overloads
+struct papso_options {
+	// Backing of the swarm-wide arrays and subswarm arenas
+	hungbiu::memory_policy memory = hungbiu::memory_policy::standard;
+	// Prefer the NUMA node of the worker that initializes a subswarm for its arena
+	bool bind_subswarms = false;
+	// Communication buffers only for particles other subswarms look at
+	bool compact = false;
+	// Size iteration chunks so a task runs about this long, zero keeps `iter_per_task`
+	// `iter_per_task` is still the size of a fork's first chunk
+	std::chrono::microseconds task_duration = std::chrono::microseconds{ 0 };
+	// Re-split the subswarms by measured cost every this many iterations, zero keeps them fixed
+	std::size_t rebalance_interval = 0;
+	// Evaluate a subswarm's particles as parallel tasks once a particle costs
+	// more than this per iteration, zero never nests
+	std::chrono::microseconds nested_evaluation_threshold = std::chrono::microseconds{ 0 };
+	// Pending evaluations per subswarm with an `async_objective`
+	std::size_t evaluations_in_flight = 4;
+	// Memo of this problem's values shared by the forks, a hit is not evaluated
+	evaluation_cache* cache = nullptr;
+	// Model of this problem's values, a particle predicted worse than its pbest
+	// by more than `surrogate_margin` standard deviations of the samples is not evaluated
+	knn_surrogate* surrogate = nullptr;
+	double surrogate_margin = 0.5;
+	// Evaluate anyway after this many skips in a row
+	std::size_t surrogate_max_skips = 8;
+	// Separable objectives: recompute a term once its coordinate moved by more than this
+	double separable_threshold = 0;
+	// Recompute every term after this many incremental evaluations of a particle,
+	// bounds the rounding drift of the running sum, zero never does
+	std::size_t separable_refresh = 64;
+	// Island model: every subswarm is a swarm of its own with the ring wrapping within it,
+	// each passes its best `migrants` to the next one every this many iterations
+	// Zero keeps a single ring over all subswarms, islands are never rebalanced
+	std::size_t migration_interval = 0;
+	std::size_t migrants = 2;
+	// The island ring continues through other processes: the first island takes
+	// the previous process's migrants, the last one offers ours to the next process
+	migration_channel* channel = nullptr;
+	// Executor job the run's tasks belong to, see `hb_executor::create_job`
+	hungbiu::hb_executor::job_id job = hungbiu::hb_executor::default_job;
+	// Warm start: particles start around these positions instead of uniformly, in blocks
+	// of the ring, one per seed, led by the seed itself. Only the first `swarm_size` are used
+	std::span<const std::vector<double>> seeds;
+	// Standard deviation of the starts around a seed, as a fraction of the feasible range
+	double seed_spread = 0.05;
+	// Seeds from, and the result recorded into, the archive's entries of `problem_id`
+	// after `seeds`, see solution_archive.h
+	solution_archive* archive = nullptr;
+	std::string problem_id;
+	// Generational PSO: the forks meet after every iteration, every particle moves towards
+	// its neighbors' pbests as of the previous one. Task sizing, rebalancing, islands and
+	// checkpoints are off
+	bool synchronous = false;
+	// Reproducible runs, synchronous: every particle draws from its own generator seeded
+	// from `seed`. The same seed gives the same result at any thread and fork count.
+	// The cache and the surrogate are off too
+	bool deterministic = false;
+	std::uint64_t seed = 0;
+	// Stop once the best value is at most this, checked at the end of every chunk
+	// (every iteration when synchronous). The default never stops early
+	double target_value = -std::numeric_limits<double>::infinity();
+	// Stop after exactly this many evaluations of the objective, initialization and immigrants
+	// included, cache hits and surrogate skips are free. `iteration` still bounds the run,
+	// a fork stopped by it leaves its unused quota to the others. Zero is no budget
+	std::size_t max_evaluations = 0;
+	// Forks draw the budget from a shared pool this many at a time,
+	// deterministic runs spend it by iteration then particle index instead
+	std::size_t evaluation_quota = 32;
+	// Snapshot of the swarm, see checkpoint.h. A run of the same shape resumes from it
+	// where every fork stopped, subswarms are then never rebalanced
+	const char* checkpoint_path = nullptr;
+	// Every fork writes its part at the end of its first chunk past this, and wherever it stops
+	std::chrono::milliseconds checkpoint_interval = std::chrono::seconds{ 10 };
 };
 
-template <typename buffer_t, size_t neighbor_size, size_t swarm_size, size_t iteration>
+// Observations of a finished run
+struct papso_stats {
+	std::size_t memory_bytes = 0; // Swarm state, communication buffers estimated
+	std::size_t tasks = 0; // Iteration chunks run by all forks
+	std::size_t rebalances = 0; // Times the subswarms have been re-split
+	std::size_t nested_evaluations = 0; // Evaluations forked off their subswarm's task
+	std::size_t cache_hits = 0;
+	std::size_t cache_misses = 0;
+	// Hits times the mean duration of the misses evaluated in process, nested ones included
+	// -1 when there were hits but every miss went to an `async_objective`, its duration is unknown
+	std::chrono::nanoseconds cache_saved_time{ 0 };
+	std::size_t surrogate_skips = 0; // Evaluations saved by the surrogate
+	std::size_t immigrants = 0; // Island mode, migrants that improved the island they joined
+	std::size_t checkpoints = 0; // Fork sections written
+	bool resumed = false; // From the checkpoint
+	// Whether `target_value` was reached, when and at the end of which iteration
+	bool reached_target = false;
+	std::chrono::nanoseconds time_to_target{ 0 };
+	std::size_t iterations_to_target = 0;
+	std::size_t evaluations = 0; // Of the objective, cache hits and surrogate skips left out
+#ifdef PAPSO2_CHECK_SNAPSHOT
+	std::size_t stale_snapshots = 0; // Synchronous mode, should stay 0
+#endif
+};
+
+// Completion latch of a run: live forks, then whether the last one is done with the state
+// Waiters seeing zero forks must not release the state before it is retired
+struct fork_latch {
+	std::atomic<std::size_t> forks{ 0 };
+	std::atomic<bool> retired{ false };
+
+	void reset() noexcept {
+		forks.store(0, std::memory_order_relaxed);
+		retired.store(false, std::memory_order_relaxed);
+	}
+	// By the last fork, as its very last touch of the state
+	void notify() noexcept {
+		forks.notify_all();
+		retired.store(true, std::memory_order_release);
+	}
+	bool is_retired() const noexcept {
+		return retired.load(std::memory_order_acquire);
+	}
+	void wait() const noexcept {
+		for (auto n = forks.load(std::memory_order_acquire); n; n = forks.load(std::memory_order_acquire)) {
+			forks.wait(n, std::memory_order_acquire);
+		}
+		while (!is_retired()) { // Past the last fork's notify
+			std::this_thread::yield();
+		}
+	}
+};
+
+// Counts a fork of `owner_t` in its `latch`, the last one out calls `complete()`
+template <typename owner_t>
+class latch_tracer {
+	owner_t* state_ptr;
+public:
+	latch_tracer(owner_t* p)
+		: state_ptr(p) {
+		p->latch.forks.fetch_add(1, std::memory_order_relaxed);
+	}
+	latch_tracer(latch_tracer&& oth) noexcept
+		: state_ptr(std::exchange(oth.state_ptr, nullptr)) {}
+	~latch_tracer() {
+		if (state_ptr && 1 == state_ptr->latch.forks.fetch_sub(1, std::memory_order_acq_rel)) {
+			state_ptr->complete();
+		}
+	}
+};
+
+// `real_t` is the precision of the particle state and the published pbests,
+// `buffer_t` holds a `std::vector<real_t>`, objectives are evaluated in double regardless
+template <typename buffer_t, size_t neighbor_size, size_t swarm_size, size_t iteration, typename real_t = double>
 class basic_papso {
+	static_assert(std::is_same_v<typename buffer_t::value_type, std::vector<real_t>>
+		, "buffer_t must hold std::vector<real_t>");
+	using real_vec_t = std::vector<real_t>;
+
 	class alignas(64) aligned_atomic_double {
 		std::atomic<double> value_;
 	public:
@@ -45,73 +247,168 @@ class basic_papso {
 		}
 	};
 
+	// Best of one subswarm, only written by the fork owning it
+	// `value` and `index` may disagree for a moment while the owner updates,
+	// both are exact once the forks have completed
+	struct alignas(64) my_fork_best {
+		std::atomic<double> value = { std::numeric_limits<double>::max() };
+		std::atomic<std::size_t> index = { 0 };
+
+		my_fork_best() {}
+		my_fork_best(my_fork_best&& oth) noexcept
+			: value(oth.value.load()), index(oth.index.load()) {}
+	};
+
+	// State private to one fork's task chain
+	struct alignas(64) my_fork_context {
+		double iteration_ns = 0; // Moving average of one iteration's duration
+		size_t tasks = 0;
+		size_t nested_evaluations = 0;
+		size_t cache_hits = 0;
+		size_t cache_misses = 0;
+		double evaluation_ns = 0; // Of the `timed_evaluations` among the misses
+		size_t timed_evaluations = 0;
+		size_t surrogate_skips = 0;
+		size_t immigrants = 0; // Accepted in place of worse particles
+		size_t checkpoints = 0;
+		std::chrono::steady_clock::time_point last_checkpoint;
+		bool restore = false; // From the checkpoint instead of initializing
+		bool initialize = false; // The subswarm, before the first chunk
+		// Evaluation budget
+		size_t evaluations = 0;
+		size_t quota = 0; // Drawn from the pool, not spent yet
+		bool exhausted = false; // Within this chunk
+		size_t generation = 0; // Synchronous: initialization is 0, iteration t is t + 1
+		// Since the last rebalance
+		double round_ns = 0;
+		size_t round_particle_iterations = 0;
+	};
+
+	struct my_separable_state {
+		double sum = 0;
+		size_t incremental = std::numeric_limits<size_t>::max(); // Since every term was computed
+	};
+
 	// particle
+	// Vectors are views into the subswarm's arena, each `dimension` long
 	struct my_particle {
 		double value;
 		double best_value;
-		vec_t velocity;
-		vec_t position;
-		vec_t best_position;
+		typename real_vec_t::iterator velocity;
+		typename real_vec_t::iterator position;
+		typename real_vec_t::iterator best_position;
 	};
 public:
 
 	using particle = my_particle;
 	using atomic_double = aligned_atomic_double;
+	using fork_best = my_fork_best;
+	using fork_context = my_fork_context;
+	using separable_state = my_separable_state;
 	using size_t = std::size_t;
 	using range_t = std::pair<size_t, size_t>;
 	using worker_handle = hungbiu::hb_executor::worker_handle;
+	template <typename T>
+	using swarm_vector = std::vector<T, hungbiu::swarm_allocator<T>>;
 
 	static constexpr size_t swarm_size = swarm_size;
 
 private:
 
-	const func_t f;
+	func_t f;
+	async_objective* af = nullptr;
+	separable_objective separable;
 	size_t dimension;
 	double min, max;
 	size_t iteration_per_task;
+	papso_options options;
 	std::atomic<particle*> gbest = { nullptr };
-	std::vector<particle> particles;
+	swarm_vector<particle> particles;
+	std::vector<range_t> subswarm_ranges;
+	std::vector<real_vec_t> arenas; // velocity, position and best_position of one subswarm's particles
 		
 	//--------------------------------
 	// Synchronization
-	std::vector<atomic_double> best_values;
-	std::vector<buffer_t> best_positions;	
+	// Published pbests, indexed by a particle's communication slot
+	// In island mode they are the islands' outboxes instead, `migrants` slots each
+	static constexpr size_t no_slot = std::numeric_limits<size_t>::max();
+	std::vector<size_t> comm_slots;
+	swarm_vector<atomic_double> best_values;
+	swarm_vector<buffer_t> best_positions;	
 	std::vector<canonical_rng> rngs;
+	std::vector<fork_best> fork_bests;
+	std::vector<fork_context> fork_contexts;
+	// Pipelined evaluation, used with `af` only
+	std::vector<std::future<double>> pending_values;
+	std::vector<size_t> particle_iterations;
+	std::vector<vec_t> async_positions; // Widened positions in flight, `real_t` other than double only
+	// Surrogate skips since each particle's last evaluation
+	std::vector<size_t> skips_in_row;
+	// Running sums of the separable objective
+	std::vector<separable_state> separable_states;
+	std::vector<vec_t> seeds; // Warm start, from the options and the archive
+	// Synchronous mode: pbests as of the end of every other iteration, iteration `t`
+	// reads those of parity `t & 1` and writes the other
+	std::vector<double> synced_values[2];
+	real_vec_t synced_positions[2];
+	size_t synced_round = 0; // Iteration of the current round
+	std::chrono::steady_clock::time_point launched;
+	std::atomic<bool> target_reached = { false };
+	std::chrono::nanoseconds time_to_target{ 0 }; // Written once by whoever sets `target_reached`
+	size_t iterations_to_target = 0;
+	alignas(64) std::atomic<size_t> evaluation_pool = { 0 }; // Budget not drawn by any fork yet
+	std::unique_ptr<swarm_checkpoint> checkpoint;
+	std::atomic<bool> flushing = { false }; // A checkpoint flush is scheduled
+	bool resumed = false;
+#ifdef PAPSO2_CHECK_SNAPSHOT
+	size_t stale_snapshots = 0; // Synchronous rounds: snapshot entries behind their pbest
+#endif
+	alignas(64) std::atomic<size_t> round_arrivals = { 0 };
+	size_t round_forks = 0; // Arrivals that end the current round, written before its forks
+	size_t rebalances = 0;
+#ifdef PAPSO2_PACKED_GBEST
+	// Global minimum as a single word: order-preserving bits of the value
+	// with the lowest bits replaced by the particle index
+	static constexpr size_t index_bits = std::bit_width(swarm_size - 1);
+	static constexpr std::uint64_t index_mask = (std::uint64_t{ 1 } << index_bits) - 1;
+	std::atomic<std::uint64_t> packed_gbest = { std::numeric_limits<std::uint64_t>::max() };
+#endif
 	//--------------------------------
 
-	std::mutex completion_mtx;
-	std::condition_variable completion_cv;
-	size_t forks = 0 ;
-
-	class fork_tracer {
-		basic_papso* state_ptr;
-	public:
-		fork_tracer(basic_papso* p) 
-			: state_ptr(p) {
-			std::lock_guard guard{ p->completion_mtx };
-			p->forks++;
-		}
-		fork_tracer(fork_tracer&& oth) noexcept
-			: state_ptr(std::exchange(oth.state_ptr, nullptr)) {}
-		~fork_tracer() {
-			if (!state_ptr) {
-				return;
-			}
+	// Completion latch: live forks, then whoever handles completion
+	static constexpr unsigned char finished = 1, continued = 2;
+	fork_latch latch;
+	std::atomic<unsigned char> completion{ 0 };
+public:
+	class papso_result_t;
+	class state_pool;
+private:
+	std::function<void(papso_result_t&)> continuation;
+	state_pool* continuation_pool = nullptr;
 
-			bool is_completed = false;
-			{ // Critical section
-				std::lock_guard guard{ state_ptr->completion_mtx };
-				state_ptr->forks--;
-				if (0 == state_ptr->forks) {
-					is_completed = true;
-				}
-			}
+	friend class latch_tracer<basic_papso>;
+	using fork_tracer = latch_tracer<basic_papso>;
 
-			if (is_completed) {
-				state_ptr->completion_cv.notify_one();
-			}
+	// By the last fork, runs the continuation or wakes the waiters
+	void complete() {
+		if (completion.fetch_or(finished, std::memory_order_acq_rel) & continued) {
+			latch.retired.store(true, std::memory_order_relaxed);
+			run_continuation();
+			return;
 		}
-	};
+		latch.notify();
+	}
+	// The continuation owns the state from here, it is moved out of it first
+	// as the state might be released or pooled by the callback
+	void run_continuation() {
+		auto callback = std::move(continuation);
+		continuation = nullptr;
+		papso_result_t result{ std::unique_ptr<basic_papso>(this), std::exchange(continuation_pool, nullptr) };
+		callback(result);
+	}
+	bool is_retired() const noexcept {
+		return latch.is_retired();
+	}
 
 public:
 	basic_papso(const func_t f, const bound_t& bounds, size_t dim, size_t iter_per_task) :
@@ -120,75 +417,625 @@ public:
 		iteration_per_task(iter_per_task) {}
 	basic_papso(const basic_papso&) = delete;
 
+	// Recycle a finished state for another problem
+	void reset(const func_t f, const bound_t& bounds, size_t dim, size_t iter_per_task) noexcept {
+		this->f = f;
+		dimension = dim;
+		min = bounds.first;
+		max = bounds.second;
+		iteration_per_task = iter_per_task;
+		gbest.store(nullptr, std::memory_order_relaxed);
+		latch.reset();
+		completion.store(0, std::memory_order_relaxed);
+	}
+
 private:
-	void initialize_state(size_t fork_count) { // Tons of allocations
+	// Split the swarm into `fork_count` subswarms, the last one takes what's left
+	void partition(size_t fork_count) {
+		subswarm_ranges.resize(fork_count);
+		size_t fork_size = swarm_size / fork_count;
+		for (size_t i = 0; i < fork_count; ++i) {
+			range_t& subswarm_range = subswarm_ranges[i];
+			subswarm_range.first = fork_size * i;
+			subswarm_range.second = (i + 1) * fork_size;
+			subswarm_range.second = std::min<size_t>(subswarm_range.second, swarm_size);
+			if (i + 1 == fork_count) {
+				subswarm_range.second = swarm_size;
+			}
+		}
+	}
+
+	// Whether a particle outside `range` has particle `i` in its neighborhood
+	bool is_boundary(size_t i, const range_t& range) const noexcept {
+		const int max_offset = neighbor_size / 2;
+		for (int offset = -max_offset; offset <= max_offset; ++offset) {
+			size_t neighbor = (i + swarm_size + offset) % swarm_size;
+			if (neighbor < range.first || range.second <= neighbor) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	size_t assign_comm_slots() {
+		comm_slots.resize(swarm_size);
+		if (options.migration_interval) { // Nobody looks outside its island
+			std::fill(comm_slots.begin(), comm_slots.end(), no_slot);
+			return subswarm_ranges.size() * options.migrants;
+		}
+		size_t slot_count = 0;
+		for (const range_t& range : subswarm_ranges) {
+			for (size_t i = range.first; i < range.second; ++i) {
+				comm_slots[i] = (!options.compact || is_boundary(i, range))
+					? slot_count++
+					: no_slot;
+			}
+		}
+		return slot_count;
+	}
+
+	// Compact slots follow the subswarm boundaries when rebalancing, sized once for any partition:
+	// a subswarm has at most `neighbor_size / 2` boundary particles at each end
+	size_t rebalanced_slot_count() const noexcept {
+		if (!options.compact || !options.rebalance_interval) {
+			return 0;
+		}
+		return std::min(swarm_size, subswarm_ranges.size() * 2 * (neighbor_size / 2));
+	}
+
+	// Allocates only when the shape differs from the previous run,
+	// particle storage is left to the forks (see `initialize_subswarm`)
+	void initialize_state() {
+		const size_t fork_count = subswarm_ranges.size();
+		if (particles.get_allocator().policy() != options.memory) {
+			hungbiu::swarm_allocator<char> alloc{ options.memory };
+			particles = swarm_vector<particle>(alloc);
+			best_values = swarm_vector<atomic_double>(alloc);
+			best_positions = swarm_vector<buffer_t>(alloc);
+			arenas.clear();
+		}
+
 		particles.resize(swarm_size);
-		best_values.resize(swarm_size);
-		best_positions.resize(swarm_size);
-		rngs.resize(fork_count);
+		const size_t slot_count = std::max(assign_comm_slots(), rebalanced_slot_count());
+		best_values.resize(slot_count);
+		best_positions.resize(slot_count);
+		if (options.deterministic) { // A generator per particle
+			rngs.resize(std::max(fork_count, swarm_size));
+			for (size_t i = 0; i < rngs.size(); ++i) {
+				rngs[i].seed(options.seed, i);
+			}
+		}
+		else {
+			rngs.resize(fork_count);
+		}
+		if (options.synchronous) {
+			for (size_t k = 0; k < 2; ++k) {
+				synced_values[k].resize(swarm_size);
+				synced_positions[k].resize(swarm_size * dimension);
+			}
+			synced_round = 0;
+		}
+		target_reached.store(false, std::memory_order_relaxed);
+		evaluation_pool.store(options.max_evaluations, std::memory_order_relaxed);
+		fork_bests.resize(fork_count);
+		fork_contexts.assign(fork_count, fork_context{});
+		if (af) {
+			pending_values.resize(swarm_size);
+			particle_iterations.resize(swarm_size);
+			if constexpr (!std::is_same_v<real_t, double>) {
+				async_positions.resize(swarm_size);
+			}
+		}
+		if (options.surrogate) {
+			skips_in_row.assign(swarm_size, 0);
+		}
+		if (separable.term) {
+			separable_states.assign(swarm_size, separable_state{});
+		}
+		round_arrivals.store(0, std::memory_order_relaxed);
+		round_forks = fork_count;
+#ifdef PAPSO2_CHECK_SNAPSHOT
+		stale_snapshots = 0;
+#endif
+		rebalances = 0;
+		arenas.resize(fork_count);
 
-		for (size_t i = 0; i < swarm_size; ++i) {
-			particle& p = particles[i];
-			p.position.resize(dimension);
-			p.best_position.resize(dimension);
-			p.velocity.resize(dimension);
-			evaluate_particle(i);
+		// Forget the previous run, a fork may look at its neighbors
+		// before they have been initialized. A pooled state may come from
+		// another dimension, no buffer is left holding a position of that one
+		const real_vec_t blank(dimension);
+		for (buffer_t& b : best_positions) {
+			b.put(blank.cbegin(), blank.cend());
+		}
+		for (atomic_double& v : best_values) {
+			v.store(std::numeric_limits<double>::max());
 		}
+		for (fork_best& fb : fork_bests) {
+			fb.value.store(std::numeric_limits<double>::max(), std::memory_order_relaxed);
+		}
+#ifdef PAPSO2_PACKED_GBEST
+		packed_gbest.store(std::numeric_limits<std::uint64_t>::max(), std::memory_order_relaxed);
+#endif
 	}
 	
-	void evaluate_particle(size_t i) noexcept {
+	void evaluate_particle(size_t i, size_t fork_idx) noexcept {
+		if (skip_evaluation(i, fork_idx)) {
+			return;
+		}
+
 		// Evaluate
 		particle& p = particles[i];
-		p.value = f(p.position.cbegin(), p.position.cend());
+		if (!evaluate(i, fork_idx, p.value)) {
+			return;
+		}
+
+		update_pbest(i, fork_idx);
+	}
 
-		// Update pbest
+	// One evaluation of particle i off the budget, false once spent
+	bool take_evaluation(size_t i, size_t fork_idx) noexcept {
+		fork_context& ctx = fork_contexts[fork_idx];
+		if (options.max_evaluations) {
+			const bool granted = options.deterministic
+				? ctx.generation * swarm_size + i < options.max_evaluations
+				: (ctx.quota || refill_quota(ctx));
+			if (!granted) {
+				ctx.exhausted = true;
+				return false;
+			}
+			if (!options.deterministic) {
+				ctx.quota--;
+			}
+		}
+		ctx.evaluations++;
+		return true;
+	}
+
+	bool refill_quota(fork_context& ctx) noexcept {
+		const size_t quota = std::max<size_t>(1, options.evaluation_quota);
+		size_t available = evaluation_pool.load(std::memory_order_relaxed);
+		do {
+			if (0 == available) {
+				return false;
+			}
+		} while (!evaluation_pool.compare_exchange_weak(available, available - std::min(available, quota), std::memory_order_relaxed));
+		ctx.quota = std::min(available, quota);
+		return true;
+	}
+
+	// Synchronous mode: whether iteration `next` may evaluate anything
+	bool budget_left(size_t next) const noexcept {
+		if (!options.max_evaluations) {
+			return true;
+		}
+		if (options.deterministic) {
+			return (next + 1) * swarm_size < options.max_evaluations;
+		}
+		return evaluation_pool.load(std::memory_order_relaxed)
+			|| std::any_of(fork_contexts.begin(), fork_contexts.end(), [](const fork_context& ctx) { return ctx.quota > 0; });
+	}
+
+	// The problem's objective at particle i's position
+	double objective(size_t i) noexcept {
+		if (separable.term) {
+			return separable_value(i);
+		}
+		const particle& p = particles[i];
+		if constexpr (std::is_same_v<real_t, double>) {
+			return f(p.position, p.position + dimension);
+		}
+		else { // Widened into a scratch of the evaluating thread
+			thread_local vec_t scratch;
+			scratch.assign(p.position, p.position + dimension);
+			return f(scratch.cbegin(), scratch.cend());
+		}
+	}
+
+	// Submit particle i's position, widened into a copy of its own if not double
+	// The submitted position must stay untouched until its result is back
+	std::future<double> submit(size_t i) {
+		const particle& p = particles[i];
+		if constexpr (std::is_same_v<real_t, double>) {
+			return af->submit(p.position, p.position + dimension);
+		}
+		else {
+			vec_t& x = async_positions[i];
+			x.assign(p.position, p.position + dimension);
+			return af->submit(x.cbegin(), x.cend());
+		}
+	}
+
+	// Terms are cached behind particle i's vectors in its arena, so are the
+	// coordinates they were computed at. Only dimensions that moved by more than
+	// `separable_threshold` are recomputed, the running sum absorbs the difference
+	double separable_value(size_t i) noexcept {
+		particle& p = particles[i];
+		separable_state& s = separable_states[i];
+		const auto terms = p.velocity + 3 * dimension;
+		const auto term_positions = terms + dimension;
+		const auto term = separable.term;
+
+		const size_t refresh = options.separable_refresh ? options.separable_refresh : std::numeric_limits<size_t>::max();
+		if (s.incremental >= refresh) {
+			// Blocked, four independent sums
+			double sums[4] = { 0, 0, 0, 0 };
+			size_t j = 0;
+			for (; j + 4 <= dimension; j += 4) {
+				for (size_t k = 0; k < 4; ++k) {
+					terms[j + k] = static_cast<real_t>(term(j + k, p.position[j + k]));
+					sums[k] += terms[j + k];
+				}
+			}
+			for (; j < dimension; ++j) {
+				terms[j] = static_cast<real_t>(term(j, p.position[j]));
+				sums[0] += terms[j];
+			}
+			std::copy_n(p.position, dimension, term_positions);
+			s.sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+			s.incremental = 0;
+		}
+		else {
+			const double threshold = options.separable_threshold;
+			for (size_t j = 0; j < dimension; ++j) {
+				if (std::abs(p.position[j] - term_positions[j]) > threshold) {
+					const real_t t = static_cast<real_t>(term(j, p.position[j]));
+					s.sum += static_cast<double>(t) - terms[j];
+					terms[j] = t;
+					term_positions[j] = p.position[j];
+				}
+			}
+			s.incremental++;
+		}
+		return separable.finalize ? separable.finalize(s.sum, dimension) : s.sum;
+	}
+
+	// f at particle i's position, through the cache if any
+	// False when the budget is spent, `value` is then left alone
+	bool evaluate(size_t i, size_t fork_idx, double& value) noexcept {
+		const particle& p = particles[i];
+		if (!options.cache) {
+			if (!take_evaluation(i, fork_idx)) {
+				return false;
+			}
+			value = objective(i);
+			add_sample(i, value);
+			return true;
+		}
+
+		const auto key = options.cache->key(&*p.position, dimension);
+		if (cached_value(key, fork_idx, value)) {
+			return true;
+		}
+		if (!take_evaluation(i, fork_idx)) {
+			return false;
+		}
+		fork_context& ctx = fork_contexts[fork_idx];
+		const auto start = std::chrono::steady_clock::now();
+		value = objective(i);
+		ctx.evaluation_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		ctx.timed_evaluations++;
+		options.cache->insert(key, value);
+		add_sample(i, value);
+		return true;
+	}
+
+	// Predicted to miss the pbest by more than the margin, the prediction becomes the value
+	bool skip_evaluation(size_t i, size_t fork_idx) noexcept {
+		if (!options.surrogate) {
+			return false;
+		}
+		particle& p = particles[i];
+		double predicted, spread;
+		if (skips_in_row[i] >= options.surrogate_max_skips
+			|| !options.surrogate->predict(&*p.position, predicted, spread)
+			|| predicted <= p.best_value + options.surrogate_margin * spread) {
+			skips_in_row[i] = 0;
+			return false;
+		}
+		p.value = predicted;
+		skips_in_row[i]++;
+		fork_contexts[fork_idx].surrogate_skips++;
+		return true;
+	}
+
+	// Train the surrogate on an evaluation of particle i's position
+	void add_sample(size_t i, double value) noexcept {
+		if (options.surrogate) {
+			options.surrogate->add(&*particles[i].position, value);
+		}
+	}
+
+	// Counts the lookup as a hit or a miss of `fork_idx`
+	bool cached_value(std::uint64_t key, size_t fork_idx, double& value) noexcept {
+		fork_context& ctx = fork_contexts[fork_idx];
+		if (options.cache->find(key, value)) {
+			ctx.cache_hits++;
+			return true;
+		}
+		ctx.cache_misses++;
+		return false;
+	}
+
+	void update_pbest(size_t i, size_t fork_idx) noexcept {
+		particle& p = particles[i];
 		if (p.value < p.best_value) {
 			p.best_value = p.value;
-			p.best_position = p.position;
+			std::copy_n(p.position, dimension, p.best_position);
 
-			// Publish
-			best_values[i].store(p.value);
-			best_positions[i].put(p.best_position);
+			publish_pbest(i);
+
+			// Update fork best
+			if (p.best_value < fork_bests[fork_idx].value.load(std::memory_order_relaxed)) {
+				publish_fork_best(fork_idx, i, p.best_value);
+			}
 		}
 	}
 
-	void initialize_swarm(canonical_rng& rng) { // Must evaluate particles first!
-		auto random_xi = [&]() {
-			return min + rng() * (max - min);
-		};
+	// Synchronous mode: every pbest into the snapshot the next iteration reads, changed or not
+	void sync_pbest(size_t i, size_t parity) noexcept {
+		const particle& p = particles[i];
+		synced_values[parity][i] = p.best_value;
+		std::copy_n(p.best_position, dimension, synced_positions[parity].begin() + i * dimension);
+	}
+
+#ifdef PAPSO2_CHECK_SNAPSHOT
+	// By the last fork of a round, every other fork waits at the boundary
+	size_t count_stale_snapshots(size_t parity) const noexcept {
+		size_t stale = 0;
+		for (size_t i = 0; i < swarm_size; ++i) {
+			const particle& p = particles[i];
+			stale += synced_values[parity][i] != p.best_value
+				|| !std::equal(p.best_position, p.best_position + dimension, synced_positions[parity].begin() + i * dimension);
+		}
+		return stale;
+	}
+#endif
+
+	// Particle i's generator, the fork's own unless deterministic
+	canonical_rng& rng_of(size_t i, size_t fork_idx) noexcept {
+		return rngs[options.deterministic ? i : fork_idx];
+	}
 
-		for (size_t i = 0; i < swarm_size; ++i) { // particle i
+	// Make the pbest visible to other subswarms, if any of them looks at it
+	void publish_pbest(size_t i) {
+		const size_t slot = comm_slots[i];
+		if (no_slot == slot) {
+			return;
+		}
+		// Position first: a reader that sees the value must find the position behind it
+		const particle& p = particles[i];
+		best_positions[slot].put(p.best_position, p.best_position + dimension);
+		best_values[slot].store(p.best_value);
+	}
+
+	void publish_fork_best(size_t fork_idx, size_t i, double v) noexcept {
+		fork_best& fb = fork_bests[fork_idx];
+		fb.index.store(i, std::memory_order_relaxed);
+		fb.value.store(v, std::memory_order_release);
+
+#ifdef PAPSO2_PACKED_GBEST
+		const std::uint64_t desired = pack_gbest(v, i);
+		std::uint64_t expected = packed_gbest.load(std::memory_order_relaxed);
+		while (desired < expected
+			&& !packed_gbest.compare_exchange_weak(expected, desired, std::memory_order_acq_rel)) {}
+#endif
+	}
+
+#ifdef PAPSO2_PACKED_GBEST
+	static std::uint64_t pack_gbest(double v, size_t i) noexcept {
+		// Flip negative values entirely and positive values' sign bit
+		// so that unsigned comparison matches the order of doubles
+		auto bits = std::bit_cast<std::uint64_t>(v);
+		bits = (bits >> 63) ? ~bits : (bits | (std::uint64_t{ 1 } << 63));
+		return (bits & ~index_mask) | i;
+	}
+#endif
+
+	// Seed the fork best from the particles it owns
+	void initialize_fork_best(size_t fork_idx, const range_t& subswarm_range) noexcept {
+		size_t best_idx = subswarm_range.first;
+		for (size_t i = subswarm_range.first; i < subswarm_range.second; ++i) {
+			if (particles[i].best_value < particles[best_idx].best_value) {
+				best_idx = i;
+			}
+		}
+		publish_fork_best(fork_idx, best_idx, particles[best_idx].best_value);
+	}
+
+	// Lay out particles in the fork's arena
+	// Arenas stay `std::vector`s, the objective takes their iterators. When advised or bound
+	// the particles start at a page boundary within it, huge when large enough, so that only
+	// whole pages of the arena's own are: a padded window instead of a mapping of its own
+	void layout_subswarm(size_t fork_idx, const range_t& subswarm_range) {
+		namespace memory = hungbiu::swarm_memory;
+		real_vec_t& arena = arenas[fork_idx];
+		// Velocity, position, best position, then terms and their coordinates if separable
+		const size_t stride = dimension * (separable.term ? 5 : 3);
+		const size_t arena_size = (subswarm_range.second - subswarm_range.first) * stride;
+		const size_t bytes = arena_size * sizeof(real_t);
+		const bool huge = hungbiu::memory_policy::huge_pages == options.memory && bytes >= memory::huge_page_threshold;
+		size_t offset = 0;
+		if (huge || options.bind_subswarms) {
+			const size_t unit = huge ? memory::huge_page_size : memory::page_size;
+			const size_t window = memory::round_up(bytes, unit);
+			if (arena.capacity() * sizeof(real_t) < window + unit) {
+				// Advise before the first touch, best effort: the allocator might hand back used memory
+				real_vec_t fresh;
+				fresh.reserve((window + unit) / sizeof(real_t));
+				std::byte* first = reinterpret_cast<std::byte*>(fresh.data()) + memory::align_offset(fresh.data(), unit);
+				if (huge) {
+					memory::advise_huge_pages(first, window);
+				}
+				if (options.bind_subswarms) {
+					memory::bind_to_node(first, window, memory::current_node());
+				}
+				arena = std::move(fresh);
+			}
+			offset = memory::align_offset(arena.data(), unit) / sizeof(real_t);
+		}
+		arena.resize(offset + arena_size);
+		auto it = arena.begin() + offset;
+		for (size_t i = subswarm_range.first; i < subswarm_range.second; ++i) {
 			particle& p = particles[i];
-			for (size_t j = 0; j < dimension; ++j) { // dimension j
-				p.position[j] = random_xi();
-				p.best_position[j] = p.position[j];
-				p.velocity[j] = (random_xi() - p.position[j]) / 2.0;
+			p.velocity = it;
+			p.position = it + dimension;
+			p.best_position = it + 2 * dimension;
+			it += stride;
+		}
+	}
+
+	// Run by the fork's first task on the worker owning it:
+	// the arena is first touched there and startup is spread across forks
+	void initialize_subswarm(size_t fork_idx, const range_t& subswarm_range, worker_handle& wh) {
+		layout_subswarm(fork_idx, subswarm_range);
+		for (size_t i = subswarm_range.first; i < subswarm_range.second; ++i) { // particle i
+			canonical_rng& rng = rng_of(i, fork_idx);
+			auto random_xi = [&]() {
+				return min + rng() * (max - min);
+			};
+			particle& p = particles[i];
+			if (!seeds.empty()) {
+				seed_particle(i, rng);
+			}
+			else {
+				for (size_t j = 0; j < dimension; ++j) { // dimension j
+					p.position[j] = static_cast<real_t>(random_xi());
+					p.best_position[j] = p.position[j];
+					p.velocity[j] = static_cast<real_t>((random_xi() - p.position[j]) / 2.0);
+				}
 			}
 
-			p.best_value = p.value = f(p.position.cbegin(), p.position.cend());
+			if (af) {
+				if (take_evaluation(i, fork_idx)) {
+					pending_values[i] = submit(i);
+				}
+				continue;
+			}
+			p.value = std::numeric_limits<double>::max(); // Never evaluated once the budget is spent
+			evaluate(i, fork_idx, p.value);
+			p.best_value = p.value;
 			
-			// Publish
-			best_values[i].store(p.best_value);
-			best_positions[i].put(p.best_position);
+			publish_pbest(i);
+		}
+
+		if (af) {
+			af->flush();
+			for (size_t i = subswarm_range.first; i < subswarm_range.second; ++i) {
+				particle& p = particles[i];
+				p.best_value = p.value = pending_values[i].valid()
+					? wh.get(pending_values[i])
+					: std::numeric_limits<double>::max();
+				publish_pbest(i);
+			}
 		}
 	}	
 	
-	particle& update_gbest() noexcept { // Thread safe!
-		particle* best_ptr = &particles.front();
-		double best_val = best_values.front().load();
+	// Warm start: particle i belongs to the block of seed `s`, the block's first particle
+	// starts at the seed standing still, the others normally around it with velocities
+	// scaled down alike
+	void seed_particle(size_t i, canonical_rng& rng) {
+		const size_t count = std::min(seeds.size(), swarm_size);
+		const size_t s = i * count / swarm_size;
+		const bool leader = (s * swarm_size + count - 1) / count == i;
+		const double sigma = options.seed_spread * (max - min);
+		auto gaussian = [&]() { // Box-Muller
+			static constexpr double two_pi = 6.283185307179586;
+			return std::sqrt(-2. * std::log(1. - rng())) * std::cos(two_pi * rng());
+		};
 
-		for (size_t i = 0; i < swarm_size; ++i) {
-			double v = best_values[i].load();
-			if (v < best_val) {				
-				best_ptr = &particles[i]; 
+		particle& p = particles[i];
+		const vec_t& seed = seeds[s];
+		for (size_t j = 0; j < dimension; ++j) {
+			const double x = std::clamp(leader ? seed[j] : seed[j] + sigma * gaussian(), min, max);
+			p.position[j] = static_cast<real_t>(x);
+			p.best_position[j] = p.position[j];
+			p.velocity[j] = leader
+				? real_t{ 0 }
+				: static_cast<real_t>(options.seed_spread * (min + rng() * (max - min) - x) / 2.0);
+		}
+	}
+
+	// A fork's checkpoint section: header, rng state, then value, pbest value,
+	// velocity, position and pbest position of each particle
+	static constexpr size_t checkpoint_rng_bytes = (canonical_rng::storage_size + 63) / 64 * 64;
+	size_t checkpoint_record_size() const noexcept {
+		return 2 * sizeof(double) + 3 * dimension * sizeof(real_t);
+	}
+
+	void write_checkpoint(size_t fork_idx, const range_t& subswarm_range, size_t completed) noexcept {
+		std::byte* out = checkpoint->inactive(fork_idx);
+		const swarm_checkpoint::fork_header h{ completed, subswarm_range.first, subswarm_range.second };
+		std::memcpy(out, &h, sizeof(h));
+		rngs[fork_idx].save(out + sizeof(h));
+		out += sizeof(h) + checkpoint_rng_bytes;
+		for (size_t i = subswarm_range.first; i < subswarm_range.second; ++i, out += checkpoint_record_size()) {
+			const particle& p = particles[i];
+			const double values[2] = { p.value, p.best_value };
+			std::memcpy(out, values, sizeof(values));
+			std::memcpy(out + sizeof(values), &*p.velocity, 3 * dimension * sizeof(real_t)); // Contiguous in the arena
+		}
+		checkpoint->commit(fork_idx);
+	}
+
+	// Instead of `initialize_subswarm`, nothing is evaluated
+	void restore_subswarm(size_t fork_idx, const range_t& subswarm_range) {
+		layout_subswarm(fork_idx, subswarm_range);
+		const std::byte* in = checkpoint->active(fork_idx);
+		rngs[fork_idx].load(in + sizeof(swarm_checkpoint::fork_header));
+		in += sizeof(swarm_checkpoint::fork_header) + checkpoint_rng_bytes;
+		for (size_t i = subswarm_range.first; i < subswarm_range.second; ++i, in += checkpoint_record_size()) {
+			particle& p = particles[i];
+			double values[2];
+			std::memcpy(values, in, sizeof(values));
+			p.value = values[0];
+			p.best_value = values[1];
+			std::memcpy(&*p.velocity, in + sizeof(values), 3 * dimension * sizeof(real_t));
+			publish_pbest(i);
+		}
+	}
+
+	// Write the fork's section when due, the mapping is flushed by a task of its own
+	// `last`: the fork stops here, at the iteration limit, the target or the end of its budget
+	void maybe_checkpoint(size_t fork_idx, const range_t& subswarm_range, size_t completed, bool last, worker_handle& wh) {
+		fork_context& ctx = fork_contexts[fork_idx];
+		const auto now = std::chrono::steady_clock::now();
+		if (!last && now - ctx.last_checkpoint < options.checkpoint_interval) {
+			return;
+		}
+		write_checkpoint(fork_idx, subswarm_range, completed);
+		ctx.last_checkpoint = now;
+		ctx.checkpoints++;
+		if (!flushing.exchange(true, std::memory_order_acquire)) {
+			wh.execute([this, tracer = fork_tracer(this)](worker_handle&) {
+				checkpoint->flush();
+				flushing.store(false, std::memory_order_release);
+			});
+		}
+	}
+
+	particle& update_gbest() noexcept { // Thread safe! O(forks)
+#ifdef PAPSO2_PACKED_GBEST
+		particle* best_ptr = &particles[packed_gbest.load(std::memory_order_acquire) & index_mask];
+#else
+		size_t best_idx = fork_bests.front().index.load(std::memory_order_relaxed);
+		double best_val = fork_bests.front().value.load(std::memory_order_acquire);
+
+		for (const fork_best& fb : fork_bests) {
+			double v = fb.value.load(std::memory_order_acquire);
+			if (v < best_val) {
+				best_idx = fb.index.load(std::memory_order_relaxed);
 				best_val = v;
 			}
 		}
+		particle* best_ptr = &particles[best_idx];
+#endif
 		gbest.store(best_ptr, std::memory_order_release);
 		return *best_ptr;
 	}
 
-	const vec_t& get_lbest_unsafe(int idx) const noexcept {
+	using real_iter = typename real_vec_t::const_iterator;
+
+	real_iter get_lbest_unsafe(int idx) const noexcept {
 		const particle* lbest_ptr = &particles[idx]; // !!Middle of neighbor
 		const int max_offset = neighbor_size / 2; // Always positive
 		// offset: [-max_offset, +max_offset]
@@ -201,8 +1048,15 @@ private:
 		return lbest_ptr->best_position;
 	}
 
-	using var_t = std::variant<const vec_t*, typename buffer_t::viewer>;
+	using var_t = std::variant<real_iter, typename buffer_t::viewer>;
 	var_t get_lbest(int idx, const range_t range) noexcept { // Thread safe!
+		if (options.synchronous) {
+			return get_synced_lbest(idx);
+		}
+		if (options.migration_interval) {
+			return real_iter{ particles[get_island_lbest(idx, range)].best_position };
+		}
+
 		size_t lbest_idx = idx;	// !!Middle of neighbor
 		double lbest_val = particles[idx].best_value;
 		const int max_offset = neighbor_size / 2; // Always positive
@@ -218,7 +1072,7 @@ private:
 
 			double v = in_range(neighbor)
 				? particles[neighbor].best_value
-				: best_values[neighbor].load();		
+				: best_values[comm_slots[neighbor]].load();		
 
 			if (v < lbest_val) {
 				lbest_val = v;
@@ -228,10 +1082,136 @@ private:
 
 		// Return
 		if (in_range(lbest_idx)) {
-			return &particles[lbest_idx].best_position;
+			return real_iter{ particles[lbest_idx].best_position };
 		}
 		else {			
-			return best_positions[lbest_idx].get();
+			return best_positions[comm_slots[lbest_idx]].get();
+		}
+	}
+
+	// Synchronous mode: the neighborhood as of the previous iteration, ties go to the lowest offset
+	real_iter get_synced_lbest(size_t idx) const noexcept {
+		const size_t parity = synced_round & 1;
+		const std::vector<double>& values = synced_values[parity];
+		size_t lbest_idx = idx;
+		const int max_offset = neighbor_size / 2;
+		for (int offset = -max_offset; offset <= max_offset; ++offset) {
+			const size_t neighbor = (idx + swarm_size + offset) % swarm_size;
+			if (values[neighbor] < values[lbest_idx]) {
+				lbest_idx = neighbor;
+			}
+		}
+		return synced_positions[parity].cbegin() + lbest_idx * dimension;
+	}
+
+	// The ring wraps within the island
+	size_t get_island_lbest(size_t idx, const range_t& range) const noexcept {
+		const std::ptrdiff_t n = range.second - range.first;
+		const int max_offset = neighbor_size / 2;
+		size_t lbest_idx = idx;
+		for (int offset = -max_offset; offset <= max_offset; ++offset) {
+			std::ptrdiff_t k = (static_cast<std::ptrdiff_t>(idx - range.first) + offset) % n;
+			const size_t neighbor = range.first + (k < 0 ? k + n : k);
+			if (particles[neighbor].best_value < particles[lbest_idx].best_value) {
+				lbest_idx = neighbor;
+			}
+		}
+		return lbest_idx;
+	}
+
+	// Island mode: the previous island's emigrants replace our worst particles when they
+	// look better, then our best take the outbox. Immigrants are evaluated here,
+	// a published value may be read together with an older position
+	void migrate(size_t fork_idx, const range_t& subswarm_range, worker_handle& wh) {
+		const size_t n = subswarm_range.second - subswarm_range.first;
+		const size_t slots = options.migrants;
+		const size_t k = std::min(slots, n);
+		const size_t islands = subswarm_ranges.size();
+		std::vector<size_t> order(n);
+		auto rank = [&]() {
+			std::iota(order.begin(), order.end(), subswarm_range.first);
+			std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+				return particles[a].best_value < particles[b].best_value;
+			});
+		};
+
+		// Other processes: the channel writes a whole migrant or nothing, straight into
+		// the particle, widened through a scratch if not double
+		migration_channel* const channel = options.channel;
+		thread_local vec_t scratch;
+		auto receive = [&](size_t r, particle& p) {
+			double value;
+			if constexpr (std::is_same_v<real_t, double>) {
+				return channel->immigrate(r, p.best_value, &*p.position, value);
+			}
+			else {
+				scratch.resize(dimension);
+				if (!channel->immigrate(r, p.best_value, scratch.data(), value)) {
+					return false;
+				}
+				std::copy(scratch.cbegin(), scratch.cend(), p.position);
+				return true;
+			}
+		};
+		auto send = [&](size_t r, const particle& p) {
+			if constexpr (std::is_same_v<real_t, double>) {
+				channel->emigrate(r, &*p.best_position, p.best_value);
+			}
+			else {
+				scratch.assign(p.best_position, p.best_position + dimension);
+				channel->emigrate(r, scratch.data(), p.best_value);
+			}
+		};
+		const bool remote_source = channel && 0 == fork_idx;
+
+		rank();
+		if (islands > 1 || remote_source) {
+			const size_t from = (fork_idx + islands - 1) % islands;
+			for (size_t r = 0; r < k; ++r) {
+				const size_t i = order[n - 1 - r];
+				particle& p = particles[i];
+				if (remote_source) {
+					if (r >= channel->migrants() || !receive(r, p)) {
+						continue;
+					}
+				}
+				else {
+					const size_t slot = from * slots + r;
+					if (!(best_values[slot].load() < p.best_value)) {
+						continue;
+					}
+					auto viewer = best_positions[slot].get();
+					std::copy(viewer->cbegin(), viewer->cend(), p.position);
+				}
+				if (af) {
+					if (!take_evaluation(i, fork_idx)) {
+						continue;
+					}
+					auto fut = submit(i);
+					af->flush();
+					p.value = wh.get(fut);
+				}
+				else if (!evaluate(i, fork_idx, p.value)) {
+					continue;
+				}
+				if (p.value < p.best_value) {
+					fork_contexts[fork_idx].immigrants++;
+				}
+				update_pbest(i, fork_idx);
+			}
+			rank();
+		}
+
+		for (size_t r = 0; r < k; ++r) {
+			const particle& p = particles[order[r]];
+			const size_t slot = fork_idx * slots + r;
+			best_positions[slot].put(p.best_position, p.best_position + dimension);
+			best_values[slot].store(p.best_value);
+		}
+		if (channel && fork_idx + 1 == islands) {
+			for (size_t r = 0; r < std::min(k, channel->migrants()); ++r) {
+				send(r, particles[order[r]]);
+			}
 		}
 	}
 
@@ -247,24 +1227,24 @@ private:
 		};
 
 		particle& p = particles[idx];
-		const vec_t& lbest =
+		const real_iter lbest =
 			(0 == lbest_var.index())
-			? *std::get<0>(lbest_var) // variant holds `const vec_t*`
-			: *std::get<1>(lbest_var); // variant holds `buffer_t::viewer`
+			? std::get<0>(lbest_var) // variant holds `real_iter` into the arena
+			: std::get<1>(lbest_var)->cbegin(); // variant holds `buffer_t::viewer`
 
 		for (size_t d = 0; d < dimension; ++d) {
-			double& vi = p.velocity[d];
-			double& xi = p.position[d];
-			vi = calculate_velocity(vi, xi, p.best_position[d], lbest[d]);
+			real_t& vi = p.velocity[d];
+			real_t& xi = p.position[d];
+			vi = static_cast<real_t>(calculate_velocity(vi, xi, p.best_position[d], lbest[d]));
 			xi += vi;
 
 			// Confinement
 			if (xi < min) {
-				xi = min;
+				xi = static_cast<real_t>(min);
 				vi = 0;
 			}
 			else if (xi > max) {
-				xi = max;
+				xi = static_cast<real_t>(max);
 				vi = 0;
 			}
 			else {
@@ -273,34 +1253,165 @@ private:
 		}
 	}
 
-	range_t make_iteration_range(size_t first) {
-		return { first
-			   , std::min(first + iteration_per_task, iteration) };
+	// Bytes held by the state, slot contents are estimated from the dimension
+	size_t memory_usage() const noexcept {
+		size_t bytes = sizeof(basic_papso);
+		bytes += particles.capacity() * sizeof(particle);
+		bytes += subswarm_ranges.capacity() * sizeof(range_t);
+		bytes += comm_slots.capacity() * sizeof(size_t);
+		bytes += best_values.capacity() * sizeof(atomic_double);
+		bytes += best_positions.capacity()
+			* (sizeof(buffer_t) + buffer_t::associativity * dimension * sizeof(real_t));
+		bytes += rngs.capacity() * (sizeof(canonical_rng) + canonical_rng::storage_size);
+		bytes += fork_bests.capacity() * sizeof(fork_best);
+		bytes += separable_states.capacity() * sizeof(separable_state);
+		for (const real_vec_t& arena : arenas) {
+			bytes += sizeof(real_vec_t) + arena.capacity() * sizeof(real_t);
+		}
+		for (size_t k = 0; k < 2; ++k) {
+			bytes += synced_values[k].capacity() * sizeof(double) + synced_positions[k].capacity() * sizeof(real_t);
+		}
+		return bytes;
 	}
 
-	auto fork(const range_t& subswarm_range, const range_t& iteration_range, canonical_rng* rng_ptr) {
-		return[this
-			, tracer = fork_tracer(this)
-			, subswarm_range, iteration_range
-			, rng_ptr] (worker_handle& wh) {
-			pso_main_loop(subswarm_range, iteration_range, rng_ptr, wh);
+	range_t make_iteration_range(size_t first, size_t fork_idx) {
+		if (options.synchronous) { // One iteration per round
+			return { first, std::min(first + 1, iteration) };
+		}
+		size_t chunk = iteration_per_task;
+		const double iteration_ns = fork_contexts[fork_idx].iteration_ns;
+		if (options.task_duration.count() && iteration_ns > 0) {
+			const double target_ns = std::chrono::duration<double, std::nano>(options.task_duration).count();
+			chunk = std::max<size_t>(1, static_cast<size_t>(target_ns / iteration_ns));
+		}
+		size_t last = std::min(first + chunk, iteration);
+		if (options.rebalance_interval) { // Stop at the next round
+			last = std::min(last, (first / options.rebalance_interval + 1) * options.rebalance_interval);
+		}
+		if (options.migration_interval) { // Stop at the next migration
+			last = std::min(last, (first / options.migration_interval + 1) * options.migration_interval);
+		}
+		return { first, last };
+	}
+
+	// Feed the measured duration of a chunk into the fork's average
+	void record_chunk(size_t fork_idx, const range_t& subswarm_range, const range_t& iteration_range, std::chrono::steady_clock::duration elapsed) noexcept {
+		fork_context& ctx = fork_contexts[fork_idx];
+		ctx.tasks++;
+		const size_t n = iteration_range.second - iteration_range.first;
+		if (0 == n) {
+			return;
+		}
+		const double elapsed_ns = std::chrono::duration<double, std::nano>(elapsed).count();
+		ctx.round_ns += elapsed_ns;
+		ctx.round_particle_iterations += n * (subswarm_range.second - subswarm_range.first);
+
+		const double sample = elapsed_ns / n;
+		ctx.iteration_ns = (ctx.iteration_ns > 0)
+			? 0.5 * ctx.iteration_ns + 0.5 * sample
+			: sample;
+	}
+
+	// Whether the fork's particles are expensive enough for a task each
+	bool use_nested_evaluation(size_t fork_idx, const range_t& subswarm_range) const noexcept {
+		const size_t n = subswarm_range.second - subswarm_range.first;
+		if (0 == options.nested_evaluation_threshold.count() || n < 2) {
+			return false;
+		}
+		const double particle_ns = fork_contexts[fork_idx].iteration_ns / n;
+		return particle_ns > std::chrono::duration<double, std::nano>(options.nested_evaluation_threshold).count();
+	}
+
+	// One iteration of a subswarm with its evaluations forked onto the executor:
+	// move everyone, evaluate in parallel, then update pbests in order
+	void nested_iteration(const range_t& subswarm_range, size_t fork_idx, worker_handle& wh) {
+		for (size_t j = subswarm_range.first; j < subswarm_range.second; ++j) {
+			move_particle(j, get_lbest(j, subswarm_range), &rng_of(j, fork_idx));
+		}
+
+		// Cache hits stay here, so do the lookups and insertions
+		std::vector<size_t> misses;
+		misses.reserve(subswarm_range.second - subswarm_range.first);
+		for (size_t j = subswarm_range.first; j < subswarm_range.second; ++j) {
+			particle& p = particles[j];
+			if (skip_evaluation(j, fork_idx)) {
+				continue; // Predicted worse than the pbest, leaves it alone
+			}
+			if ((!options.cache || !cached_value(options.cache->key(&*p.position, dimension), fork_idx, p.value))
+				&& take_evaluation(j, fork_idx)) {
+				misses.push_back(j);
+			}
+		}
+		if (misses.empty()) {
+			for (size_t j = subswarm_range.first; j < subswarm_range.second; ++j) {
+				update_pbest(j, fork_idx);
+			}
+			return;
+		}
+
+		// Each evaluation timed where it runs, for the cache's saved time
+		std::vector<double> evaluation_ns(misses.size());
+		auto evaluate_miss = [this](size_t j, double& ns) {
+			const auto start = std::chrono::steady_clock::now();
+			particles[j].value = objective(j);
+			ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
 		};
+		std::vector<hungbiu::hb_executor::future_t<void>> evaluations;
+		evaluations.reserve(misses.size() - 1);
+		for (size_t k = 1; k < misses.size(); ++k) {
+			evaluations.push_back(wh.execute_return([&evaluate_miss, j = misses[k], &ns = evaluation_ns[k]](worker_handle&) {
+				evaluate_miss(j, ns);
+				}));
+		}
+		evaluate_miss(misses.front(), evaluation_ns.front()); // Keep one for ourselves
+
+		// Join, running other tasks meanwhile
+		for (auto& fut : evaluations) {
+			wh.get(fut);
+		}
+		fork_context& ctx = fork_contexts[fork_idx];
+		ctx.nested_evaluations += evaluations.size();
+		if (options.cache) {
+			ctx.evaluation_ns += std::accumulate(evaluation_ns.cbegin(), evaluation_ns.cend(), 0.);
+			ctx.timed_evaluations += misses.size();
+		}
+		for (size_t j : misses) {
+			if (options.cache) {
+				options.cache->insert(options.cache->key(&*particles[j].position, dimension), particles[j].value);
+			}
+			add_sample(j, particles[j].value);
+		}
+
+		for (size_t j = subswarm_range.first; j < subswarm_range.second; ++j) {
+			update_pbest(j, fork_idx);
+		}
 	}
 
-	void pso_main_loop(range_t subswarm_range, range_t iteration_range, canonical_rng* rng_ptr, worker_handle& wh) {
+	// Chunk of a subswarm, particles move and evaluate in order
+	void iterations(const range_t& subswarm_range, const range_t& iteration_range, size_t fork_idx, worker_handle& wh) {
+		const bool nested = use_nested_evaluation(fork_idx, subswarm_range);
 		// Loop
-		for (size_t i = iteration_range.first; i < iteration_range.second; ++i) {
-			for (size_t j = subswarm_range.first; j < subswarm_range.second; ++j) {
-				// Lbest				
-				// const vec_t& lbest = get_lbest_unsafe(j);
-				var_t lbest_var = get_lbest(j, subswarm_range);
+		const bool& exhausted = fork_contexts[fork_idx].exhausted;
+		for (size_t i = iteration_range.first; i < iteration_range.second && !exhausted; ++i) {
+			if (nested) {
+				nested_iteration(subswarm_range, fork_idx, wh);
+			}
+			else {
+				for (size_t j = subswarm_range.first; j < subswarm_range.second; ++j) {
+					// Lbest				
+					// const vec_t& lbest = get_lbest_unsafe(j);
+					var_t lbest_var = get_lbest(j, subswarm_range);
 
-				// Update velocity, position				
-				move_particle(j, std::move(lbest_var), rng_ptr); // Sink
+					// Update velocity, position				
+					move_particle(j, std::move(lbest_var), &rng_of(j, fork_idx)); // Sink
 
-				evaluate_particle(j);
+					evaluate_particle(j, fork_idx);
+					if (exhausted) {
+						return;
+					}
 
-			} // end of particle
+				} // end of particle
+			}
 
 #ifdef PAPSO2_TRACK_CONVERGENCY
 				// Only one subswarm would periodly update, print global best
@@ -312,54 +1423,480 @@ private:
 				}
 #endif
 		} // end of iteration
+	}
+
+	// Chunk of a subswarm with an asynchronous objective: keep up to `evaluations_in_flight`
+	// evaluations pending, update pbests as results arrive and move whoever is back
+	// Particles run freely within the chunk and meet at its end
+	void async_iterations(const range_t& subswarm_range, const range_t& iteration_range, size_t fork_idx, worker_handle& wh) {
+		const size_t window = std::max<size_t>(1, options.evaluations_in_flight);
+		size_t in_flight = 0;
+		size_t remaining = (iteration_range.second - iteration_range.first)
+			* (subswarm_range.second - subswarm_range.first);
+		for (size_t j = subswarm_range.first; j < subswarm_range.second; ++j) {
+			particle_iterations[j] = iteration_range.first;
+		}
+
+		auto complete = [&](size_t j, double value) {
+			particles[j].value = value;
+			if (options.cache) { // Submitted positions are untouched until their result is back
+				options.cache->insert(options.cache->key(&*particles[j].position, dimension), value);
+			}
+			add_sample(j, value);
+			update_pbest(j, fork_idx);
+			particle_iterations[j]++;
+			in_flight--;
+			remaining--;
+		};
+
+		while (remaining) {
+			bool progress = false, submitted = false;
+			for (size_t j = subswarm_range.first; j < subswarm_range.second; ++j) {
+				auto& fut = pending_values[j];
+				if (fut.valid()) {
+					if (worker_handle::future_ready(fut)) {
+						complete(j, fut.get());
+						progress = true;
+					}
+				}
+				else if (particle_iterations[j] < iteration_range.second && in_flight < window
+					&& !fork_contexts[fork_idx].exhausted) {
+					move_particle(j, get_lbest(j, subswarm_range), &rng_of(j, fork_idx));
+					const particle& p = particles[j];
+					if (skip_evaluation(j, fork_idx)) {
+						particle_iterations[j]++;
+						remaining--;
+						progress = true;
+						continue;
+					}
+					double value;
+					if (options.cache
+						&& cached_value(options.cache->key(&*p.position, dimension), fork_idx, value)) {
+						particles[j].value = value;
+						update_pbest(j, fork_idx);
+						particle_iterations[j]++;
+						remaining--;
+						progress = true;
+						continue;
+					}
+					if (!take_evaluation(j, fork_idx)) { // Only the ones in flight left
+						remaining = in_flight;
+						continue;
+					}
+					fut = submit(j);
+					in_flight++;
+					progress = submitted = true;
+				}
+			}
+			if (submitted) {
+				af->flush();
+			}
+
+			if (!progress) { // Wait for one, running other tasks meanwhile
+				for (size_t j = subswarm_range.first; j < subswarm_range.second; ++j) {
+					if (pending_values[j].valid()) {
+						complete(j, wh.get(pending_values[j]));
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	// Split the swarm again so that every subswarm costs about the same,
+	// a particle is charged what its subswarm measured per particle-iteration
+	// Only while every fork waits at the round boundary
+	void rebalance() {
+		const size_t fork_count = subswarm_ranges.size();
+		std::vector<double> unit_costs(fork_count);
+		double total = 0;
+		for (size_t f = 0; f < fork_count; ++f) {
+			fork_context& ctx = fork_contexts[f];
+			if (0 == ctx.round_particle_iterations) {
+				return; // Nothing measured
+			}
+			unit_costs[f] = ctx.round_ns / ctx.round_particle_iterations;
+			total += unit_costs[f] * (subswarm_ranges[f].second - subswarm_ranges[f].first);
+			ctx.round_ns = 0;
+			ctx.round_particle_iterations = 0;
+		}
+
+		const double share = total / fork_count;
+		std::vector<range_t> ranges(fork_count);
+		size_t old_fork = 0, k = 0, first = 0;
+		double acc = 0;
+		for (size_t i = 0; i < swarm_size && k + 1 < fork_count; ++i) {
+			while (subswarm_ranges[old_fork].second <= i) {
+				++old_fork;
+			}
+			acc += unit_costs[old_fork];
+
+			// Every subswarm keeps at least one particle
+			const size_t left = swarm_size - (i + 1);
+			const size_t forks_left = fork_count - (k + 1);
+			if ((acc >= share * (k + 1) && left >= forks_left) || left == forks_left) {
+				ranges[k++] = { first, i + 1 };
+				first = i + 1;
+			}
+		}
+		ranges[k] = { first, swarm_size };
+		subswarm_ranges = std::move(ranges);
+		rebalances++;
+
+		// New boundaries, new readers. Slots are only remapped, never reallocated:
+		// nobody holds a viewer while every fork waits at the round boundary
+		if (options.compact) {
+			assign_comm_slots();
+			for (size_t i = 0; i < swarm_size; ++i) {
+				publish_pbest(i);
+			}
+		}
+		for (size_t f = 0; f < fork_count; ++f) {
+			initialize_fork_best(f, subswarm_ranges[f]);
+		}
+	}
+
+	auto fork(const range_t& subswarm_range, const range_t& iteration_range, size_t fork_idx) {
+		return[this
+			, tracer = fork_tracer(this)
+			, subswarm_range, iteration_range
+			, fork_idx] (worker_handle& wh) {
+			pso_main_loop(subswarm_range, iteration_range, fork_idx, wh);
+		};
+	}
+
+	void pso_main_loop(range_t subswarm_range, range_t iteration_range, size_t fork_idx, worker_handle& wh) {
+		fork_context& ctx = fork_contexts[fork_idx];
+		ctx.exhausted = false;
+		if (ctx.restore) {
+			ctx.restore = false;
+			restore_subswarm(fork_idx, subswarm_range);
+			initialize_fork_best(fork_idx, subswarm_range);
+		}
+		else if (ctx.initialize) {
+			ctx.initialize = false;
+			ctx.generation = 0;
+			initialize_subswarm(fork_idx, subswarm_range, wh);
+			initialize_fork_best(fork_idx, subswarm_range);
+			if (options.synchronous) { // Read by the first iteration, a round of its own
+				for (size_t i = subswarm_range.first; i < subswarm_range.second; ++i) {
+					sync_pbest(i, 0);
+				}
+			}
+		}
+
+		ctx.generation = iteration_range.first + 1;
+		const auto chunk_start = std::chrono::steady_clock::now();
+		if (af) {
+			async_iterations(subswarm_range, iteration_range, fork_idx, wh);
+		}
+		else {
+			iterations(subswarm_range, iteration_range, fork_idx, wh);
+		}
+		// Skipped, refused by the budget or not reached: every pbest goes into the snapshot
+		if (options.synchronous && iteration_range.first < iteration_range.second) {
+			for (size_t i = subswarm_range.first; i < subswarm_range.second; ++i) {
+				sync_pbest(i, iteration_range.second & 1);
+			}
+		}
+		record_chunk(fork_idx, subswarm_range, iteration_range, std::chrono::steady_clock::now() - chunk_start);
+
+		if (options.migration_interval && 0 == iteration_range.second % options.migration_interval) {
+			migrate(fork_idx, subswarm_range, wh);
+		}
+
+		// Refit the surrogate in the background, the run waits for it like for a fork
+		if (options.surrogate && options.surrogate->claim_rebuild()) {
+			wh.execute([surrogate = options.surrogate, tracer = fork_tracer(this)](worker_handle&) {
+				surrogate->rebuild();
+			});
+		}
+
+		// Done, what is left of the quota goes back to the others
+		if (iteration_range.second >= iteration && ctx.quota) {
+			evaluation_pool.fetch_add(std::exchange(ctx.quota, 0), std::memory_order_relaxed);
+		}
+		// Target reached by anyone, nobody forks again
+		if (fork_bests[fork_idx].value.load(std::memory_order_relaxed) <= options.target_value
+			&& !target_reached.exchange(true, std::memory_order_acq_rel)) {
+			time_to_target = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - launched);
+			iterations_to_target = iteration_range.second;
+		}
+		// The last section of a fork is always written, however it stops
+		if (checkpoint) {
+			const bool stopping = iteration_range.second >= iteration
+				|| target_reached.load(std::memory_order_acquire) || ctx.exhausted;
+			maybe_checkpoint(fork_idx, subswarm_range, iteration_range.second, stopping, wh);
+		}
+		if (target_reached.load(std::memory_order_acquire)) {
+			return;
+		}
+		// Round boundary: the last fork to arrive re-splits, or moves on to the next
+		// iteration's snapshot when synchronous, and forks everyone
+		// Budget spent: synchronous forks go on while any fork has quota left, free running
+		// ones arrive at once so that their round ends, but are not forked again
+		const size_t round_interval = options.synchronous ? 1 : options.rebalance_interval;
+		const size_t round_iteration = round_interval
+			? (iteration_range.second + round_interval - 1) / round_interval * round_interval
+			: iteration_range.second;
+		const bool round_end = round_interval
+			&& (round_iteration == iteration_range.second || ctx.exhausted);
+		if (round_end && round_iteration < iteration) {
+			const size_t fork_count = subswarm_ranges.size();
+			if (round_arrivals.fetch_add(1, std::memory_order_acq_rel) + 1 < round_forks) {
+				return;
+			}
+			round_arrivals.store(0, std::memory_order_relaxed);
+			const auto stopped = [this](size_t f) {
+				return !options.synchronous && fork_contexts[f].exhausted;
+			};
+			if (options.synchronous) {
+#ifdef PAPSO2_CHECK_SNAPSHOT
+				stale_snapshots += count_stale_snapshots(round_iteration & 1);
+#endif
+				if (!budget_left(round_iteration)) {
+					return;
+				}
+				synced_round = round_iteration;
+			}
+			else if (std::none_of(fork_contexts.begin(), fork_contexts.end(), [](const fork_context& c) { return c.exhausted; })) {
+				rebalance(); // Not with an empty pool, a stopped fork would keep its new share idle
+			}
+			round_forks = 0;
+			for (size_t f = 0; f < fork_count; ++f) {
+				round_forks += !stopped(f);
+			}
+			for (size_t f = 0; f < fork_count; ++f) {
+				if (!stopped(f)) {
+					range_t next_iter_range = make_iteration_range(round_iteration, f);
+					wh.execute( fork(subswarm_ranges[f], next_iter_range, f) );
+				}
+			}
+			return;
+		}
+		if (ctx.exhausted && !options.synchronous) {
+			return;
+		}
 		
 		// Fork next iterations
 		if (iteration_range.second < iteration) {
-			range_t next_iter_range = make_iteration_range(iteration_range.second);
-			wh.execute( fork(subswarm_range, next_iter_range, rng_ptr) );			
+			range_t next_iter_range = make_iteration_range(iteration_range.second, fork_idx);
+			wh.execute( fork(subswarm_range, next_iter_range, fork_idx) );			
 		}
 	}
 
 public:
-
 	class papso_result_t {
 		std::unique_ptr<basic_papso> state_;
+		state_pool* pool_;
+		papso_stats stats_;
 	public:
-		papso_result_t(std::unique_ptr<basic_papso> state)
-			: state_(std::move(state)) {}
+		papso_result_t(std::unique_ptr<basic_papso> state, state_pool* pool = nullptr)
+			: state_(std::move(state)), pool_(pool) {}
 		papso_result_t(papso_result_t&& oth) noexcept
-			: state_(std::move(oth.state_)) {}
+			: state_(std::move(oth.state_)), pool_(oth.pool_), stats_(oth.stats_) {}
 		papso_result_t& operator= (papso_result_t&& rhs) noexcept {
 			state_ = std::move(rhs.state_);
+			pool_ = rhs.pool_;
+			stats_ = rhs.stats_;
 			return *this;
 		}
 
+		// Valid after `get()`
+		const papso_stats& stats() const noexcept {
+			return stats_;
+		}
+
+		bool is_ready() const noexcept {
+			return state_->is_retired();
+		}
+
+		// Wait no longer than `timeout`, true once finished
+		// There is no timed wait on an atomic, sleeps grow from 50us up to 1ms
+		template <typename Rep, typename Period>
+		bool wait_for(std::chrono::duration<Rep, Period> timeout) const {
+			const auto deadline = std::chrono::steady_clock::now() + timeout;
+			std::chrono::microseconds nap{ 50 };
+			while (!is_ready()) {
+				const auto now = std::chrono::steady_clock::now();
+				if (now >= deadline) {
+					return false;
+				}
+				std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(nap, deadline - now));
+				nap = std::min(nap * 2, std::chrono::microseconds{ 1000 });
+			}
+			return true;
+		}
+
+		// The result if finished, never blocks
+		std::optional<std::tuple<double, vec_t>> try_get() {
+			if (!is_ready()) {
+				return std::nullopt;
+			}
+			return get();
+		}
+
+		// `callback(result)` once finished, on the thread running the last fork
+		// (or right here if already finished), `result.get()` does not block there
+		// Takes over the result, this one is left empty
+		void then(std::function<void(papso_result_t&)> callback) {
+			basic_papso* state = state_.release();
+			state->continuation = std::move(callback);
+			state->continuation_pool = pool_;
+			if (state->completion.fetch_or(continued, std::memory_order_acq_rel) & finished) {
+				while (!state->is_retired()) { // The last fork is about to
+					std::this_thread::yield();
+				}
+				state->run_continuation();
+			}
+		}
+
 		// Block until finished
 		std::tuple<double, vec_t> get() {
 			auto& state = *state_;
-			auto check_for_completion = [&]() {
-				bool is_completed = (0 == state.forks);
-				return is_completed;
-			};
 
 			// Wait for finish
-			{
-				std::unique_lock lock{ state.completion_mtx };
-				state.completion_cv.wait(lock, check_for_completion);
+			state.latch.wait();
+			if (state.checkpoint) { // Every fork has written its last section
+				state.checkpoint->flush();
+				state.checkpoint.reset();
 			}
 
-			// Get result
-			auto& gbest = state.update_gbest();
+			// Get result, the lowest index among equals when deterministic
+			auto& gbest = state.options.deterministic
+				? *std::min_element(state.particles.begin(), state.particles.end()
+					, [](const particle& a, const particle& b) { return a.best_value < b.best_value; })
+				: state.update_gbest();
 			double best_value = gbest.best_value;
-			vec_t best_position = std::move(gbest.best_position);
-			state_.reset(); // Release resource
+			vec_t best_position(gbest.best_position, gbest.best_position + state.dimension);
+			stats_.memory_bytes = state.memory_usage();
+			stats_.tasks = 0;
+			for (const fork_context& ctx : state.fork_contexts) {
+				stats_.tasks += ctx.tasks;
+			}
+			if (state.options.archive && !state.options.problem_id.empty()) {
+				state.options.archive->record(state.options.problem_id, best_value, best_position);
+			}
+			stats_.rebalances = state.rebalances;
+#ifdef PAPSO2_CHECK_SNAPSHOT
+			stats_.stale_snapshots = state.stale_snapshots;
+#endif
+			stats_.resumed = state.resumed;
+			stats_.reached_target = state.target_reached.load(std::memory_order_relaxed);
+			stats_.time_to_target = state.time_to_target;
+			stats_.iterations_to_target = state.iterations_to_target;
+			stats_.nested_evaluations = 0;
+			stats_.cache_hits = stats_.cache_misses = 0;
+			stats_.surrogate_skips = 0;
+			stats_.immigrants = 0;
+			stats_.checkpoints = 0;
+			stats_.evaluations = 0;
+			double evaluation_ns = 0;
+			size_t timed_evaluations = 0;
+			for (const fork_context& ctx : state.fork_contexts) {
+				stats_.nested_evaluations += ctx.nested_evaluations;
+				stats_.cache_hits += ctx.cache_hits;
+				stats_.cache_misses += ctx.cache_misses;
+				stats_.surrogate_skips += ctx.surrogate_skips;
+				stats_.immigrants += ctx.immigrants;
+				stats_.checkpoints += ctx.checkpoints;
+				stats_.evaluations += ctx.evaluations;
+				evaluation_ns += ctx.evaluation_ns;
+				timed_evaluations += ctx.timed_evaluations;
+			}
+			if (timed_evaluations) {
+				stats_.cache_saved_time = std::chrono::nanoseconds{ static_cast<std::int64_t>(evaluation_ns / timed_evaluations * stats_.cache_hits) };
+			}
+			else { // Hits but no miss timed, every one was asynchronous
+				stats_.cache_saved_time = std::chrono::nanoseconds{ stats_.cache_hits ? -1 : 0 };
+			}
+			if (pool_) {
+				pool_->release(std::move(state_)); // Keep for the next run
+			}
+			else {
+				state_.reset(); // Release resource
+			}
 			return { best_value, std::move(best_position) };
 		}
 	};
 
-	static auto parallel_async_pso(hungbiu::hb_executor& etor, size_t fork_count, size_t iter_per_task, const optimization_problem_t& problem) {
+	// Finished states kept for reuse, runs of the same dimension
+	// recycle the arenas and buffers without allocating
+	class state_pool {
+		std::mutex mtx_;
+		std::vector<std::unique_ptr<basic_papso>> free_;
+	public:
+		state_pool() {}
+		state_pool(const state_pool&) = delete;
+
+		std::unique_ptr<basic_papso> acquire(const optimization_problem_t& problem, size_t iter_per_task) {
+			std::unique_ptr<basic_papso> state;
+			{ // Critical section
+				std::lock_guard guard{ mtx_ };
+				if (!free_.empty()) {
+					// Prefer a state of the same shape
+					auto it = std::find_if(free_.begin(), free_.end(), [&](const auto& s) {
+						return s->dimension == problem.dimension;
+						});
+					if (it == free_.end()) {
+						it = std::prev(free_.end());
+					}
+					state = std::move(*it);
+					free_.erase(it);
+				}
+			}
+
+			if (state) {
+				state->reset(problem.function, problem.feasible_bound, problem.dimension, iter_per_task);
+			}
+			else {
+				state = std::make_unique<basic_papso>(problem.function, problem.feasible_bound, problem.dimension, iter_per_task);
+			}
+			return state;
+		}
+
+		void release(std::unique_ptr<basic_papso> state) {
+			std::lock_guard guard{ mtx_ };
+			free_.push_back(std::move(state));
+		}
+	};
+
+	static auto parallel_async_pso(hungbiu::hb_executor& etor, size_t fork_count, size_t iter_per_task, const optimization_problem_t& problem, const papso_options& options = {}) {
 		auto pso_state_uptr = std::make_unique<basic_papso>(problem.function, problem.feasible_bound, problem.dimension, iter_per_task);
+		return launch(etor, std::move(pso_state_uptr), problem, fork_count, options, nullptr);
+	}
+
+	// Same as above, with the state taken from and returned to `pool`
+	static auto parallel_async_pso(hungbiu::hb_executor& etor, state_pool& pool, size_t fork_count, size_t iter_per_task, const optimization_problem_t& problem, const papso_options& options = {}) {
+		return launch(etor, pool.acquire(problem, iter_per_task), problem, fork_count, options, &pool);
+	}
+
+private:
+	static papso_result_t launch(hungbiu::hb_executor& etor, std::unique_ptr<basic_papso> pso_state_uptr, const optimization_problem_t& problem
+		, size_t fork_count, const papso_options& options, state_pool* pool) {
 		auto& state = *pso_state_uptr;
+		state.options = options;
+		if (options.deterministic) {
+			state.options.synchronous = true;
+			state.options.cache = nullptr;
+			state.options.surrogate = nullptr;
+		}
+		if (state.options.synchronous) {
+			state.options.task_duration = std::chrono::microseconds{ 0 };
+			state.options.rebalance_interval = 0;
+			state.options.migration_interval = 0;
+			state.options.channel = nullptr;
+			state.options.checkpoint_path = nullptr;
+		}
+		if (state.options.migration_interval) {
+			state.options.rebalance_interval = 0;
+			state.options.migrants = std::max<size_t>(1, options.migrants);
+		}
+		if (state.options.checkpoint_path) { // Sections have a fixed subswarm each
+			state.options.rebalance_interval = 0;
+		}
+		state.af = problem.async_function;
+		state.separable = problem.async_function ? separable_objective{} : problem.separable;
 
 		using worker_handle = hungbiu::hb_executor::worker_handle;
 
@@ -368,26 +1905,73 @@ public:
 		if (remainder) {
 			++fork_count;
 		}
-		state.initialize_state(fork_count);
-		state.initialize_swarm(state.rngs[0]);
+		state.partition(fork_count);
+		state.initialize_state();
 
-		// Forks
-		size_t fork_size = swarm_size / fork_count;
-		for (size_t i = 0; i < fork_count; ++i) {
-			range_t subswarm_range;
-			subswarm_range.first = fork_size * i;
-			subswarm_range.second = (i + 1)* fork_size;
-			subswarm_range.second = std::min<size_t>(subswarm_range.second, swarm_size);
+		// Warm start
+		state.seeds.clear();
+		for (const vec_t& seed : options.seeds) {
+			if (seed.size() == state.dimension) {
+				state.seeds.push_back(seed);
+			}
+		}
+		if (options.archive && !options.problem_id.empty()) {
+			for (vec_t& seed : options.archive->seeds(options.problem_id, state.dimension)) {
+				state.seeds.push_back(std::move(seed));
+			}
+		}
 
-			range_t iter_range = state.make_iteration_range(0);
+		// Resume where every fork stopped when the checkpoint has the same shape
+		std::vector<size_t> start(fork_count, 0);
+		state.resumed = false;
+		if (state.options.checkpoint_path) {
+			size_t largest = 0;
+			for (const range_t& range : state.subswarm_ranges) {
+				largest = std::max(largest, range.second - range.first);
+			}
+			swarm_checkpoint::shape_t shape;
+			shape.dimension = state.dimension;
+			shape.swarm_size = swarm_size;
+			shape.fork_count = fork_count;
+			shape.real_size = sizeof(real_t);
+			shape.slot_size = sizeof(swarm_checkpoint::fork_header) + checkpoint_rng_bytes
+				+ largest * state.checkpoint_record_size();
+			state.checkpoint = std::make_unique<swarm_checkpoint>(options.checkpoint_path, shape);
+			state.resumed = state.checkpoint->resumable();
+			for (size_t i = 0; i < fork_count; ++i) {
+				fork_context& ctx = state.fork_contexts[i];
+				ctx.last_checkpoint = std::chrono::steady_clock::now();
+				if (state.resumed) {
+					swarm_checkpoint::fork_header h;
+					std::memcpy(&h, state.checkpoint->active(i), sizeof(h));
+					start[i] = std::min<size_t>(h.iteration, iteration);
+					ctx.restore = true;
+				}
+			}
+		}
+
+		// Forks, the launch counts as one until all are out
+		// so that early finishers cannot complete the run
+		state.launched = std::chrono::steady_clock::now();
+		{
+			fork_tracer launching(&state);
+			for (size_t i = 0; i < fork_count; ++i) {
+				fork_context& ctx = state.fork_contexts[i];
+				ctx.initialize = !ctx.restore;
+				// Synchronous: initialization is a round of its own
+				range_t iter_range = state.options.synchronous
+					? range_t{ 0, 0 }
+					: state.make_iteration_range(start[i], i);
 
-			etor.execute( state.fork(subswarm_range, iter_range, &state.rngs[i]) );
+				etor.execute( options.job, state.fork(state.subswarm_ranges[i], iter_range, i) );
+			}
 		}
 
-		return basic_papso::papso_result_t{ std::move(pso_state_uptr) };
+		return basic_papso::papso_result_t{ std::move(pso_state_uptr), pool };
 	}
 };
 
 using papso = basic_papso<hungbiu::spmc_buffer<vec_t>, 2, 40, 5000>;
+using papso_f32 = basic_papso<hungbiu::spmc_buffer<std::vector<float>>, 2, 40, 5000, float>;
 
 #endif
@@ -1,8 +1,115 @@
 #ifndef _PAPSO_TEST
 #define _PAPSO_TEST
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
 #include "papso2.h"
 #include "test_functions.h"
 
+// A job released while its forks are still queued: they must all run
+inline bool release_job_with_queued_forks_test(hungbiu::hb_executor& etor) {
+	static constexpr int fork_count = 64;
+	std::atomic<int> forked{ 0 }, ran{ 0 };
+	std::atomic<bool> released{ false }, returned{ false };
+
+	const auto job = etor.create_job().value();
+	etor.execute(job, [&](hungbiu::hb_executor::worker_handle& wh) {
+		for (int i = 0; i < fork_count; ++i) {
+			wh.execute([&](hungbiu::hb_executor::worker_handle&) { ran.fetch_add(1); });
+		}
+		forked.store(1);
+		while (!released.load()) { // Keep the forks queued until the job is gone
+			std::this_thread::yield();
+		}
+		returned.store(true);
+	});
+	while (!forked.load()) {
+		std::this_thread::yield();
+	}
+	etor.release_job(job);
+	released.store(true);
+
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 5 };
+	while ((ran.load() < fork_count || !returned.load()) && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+	}
+	const bool passed = fork_count == ran.load() && returned.load();
+	std::printf("release job with queued forks: %s (%d/%d)\n", passed ? "passed" : "FAILED", ran.load(), fork_count);
+	return passed;
+}
+
+// Every slot taken: no job instead of the default one, until a slot is released
+inline bool job_slots_exhausted_test(hungbiu::hb_executor& etor) {
+	std::vector<hungbiu::hb_executor::job_id> jobs;
+	while (auto job = etor.create_job()) {
+		jobs.push_back(*job);
+	}
+	const std::size_t created = jobs.size();
+	etor.release_job(jobs.back());
+	jobs.pop_back();
+	const auto reused = etor.create_job();
+	if (reused) {
+		jobs.push_back(*reused);
+	}
+	for (auto job : jobs) {
+		etor.release_job(job);
+	}
+	const bool passed = hungbiu::hb_executor::max_jobs - 1 == created && reused;
+	std::printf("job slots exhausted: %s (%zu/%zu)\n", passed ? "passed" : "FAILED", created, hungbiu::hb_executor::max_jobs - 1);
+	return passed;
+}
+
+// Rebalancing rounds with an evaluation budget: exactly the budget must be spent
+template <typename papso_t>
+bool evaluation_budget_with_rebalance_test(hungbiu::hb_executor& etor, std::size_t fork_count) {
+	static constexpr std::size_t budget = 20000;
+	const optimization_problem_t problem{ test_functions::functions[0], test_functions::bounds[0], test_functions::dimensions[0] };
+	papso_options options;
+	options.rebalance_interval = 50;
+	options.max_evaluations = budget;
+	options.evaluation_quota = 7;
+
+	auto result = papso_t::parallel_async_pso(etor, fork_count, 10, problem, options);
+	result.get();
+	const bool passed = budget == result.stats().evaluations;
+	std::printf("evaluation budget with rebalance: %s (%zu/%zu)\n", passed ? "passed" : "FAILED", result.stats().evaluations, budget);
+	return passed;
+}
+
+#ifdef PAPSO2_CHECK_SNAPSHOT
+// Synchronous rounds where particles skip their evaluation, by the surrogate
+// or for want of budget: the snapshot must still hold every current pbest
+template <typename papso_t>
+bool synchronous_snapshot_test(hungbiu::hb_executor& etor, std::size_t fork_count) {
+	const optimization_problem_t problem{ test_functions::functions[0], test_functions::bounds[0], test_functions::dimensions[0] };
+	knn_surrogate surrogate(problem.dimension, 4, 128, 16, 16);
+	bool passed = true;
+	for (int with_budget = 0; with_budget < 2; ++with_budget) {
+		papso_options options;
+		options.synchronous = true;
+		if (with_budget) {
+			options.max_evaluations = 5001;
+			options.evaluation_quota = 7;
+		}
+		else {
+			options.surrogate = &surrogate;
+			options.surrogate_margin = 0;
+		}
+
+		auto result = papso_t::parallel_async_pso(etor, fork_count, 1, problem, options);
+		result.get();
+		const auto& stats = result.stats();
+		const bool ok = 0 == stats.stale_snapshots
+			&& (with_budget ? options.max_evaluations == stats.evaluations : stats.surrogate_skips > 0);
+		std::printf("synchronous snapshot with %s: %s (%zu stale)\n", with_budget ? "budget" : "surrogate"
+			, ok ? "passed" : "FAILED", stats.stale_snapshots);
+		passed = passed && ok;
+	}
+	return passed;
+}
+#endif
+
 template <typename papso_t>
 void parallel_async_pso_benchmark(
 	hungbiu::hb_executor& etor
@@ -15,6 +122,7 @@ void parallel_async_pso_benchmark(
 		auto result = papso_t::parallel_async_pso(etor, fork_count, iter_per_task, problem);
 		auto [v, pos] = result.get(); // Could be wasting?
 		printf_s("\npar async pso @%s: %lf\n", msg, v);
+		std::printf("memory: %zu KiB\n", result.stats().memory_bytes / 1024);
 #ifdef COUNT_STEALING
 		std::printf("steal count: %llu\n", etor.get_steal_count());
 #endif
@@ -0,0 +1,475 @@
+/*
+* Objective evaluated by a pool of worker processes
+* For objectives that are not thread safe. Positions and results travel
+* through rings in a shared mapping, a futex is only touched to wake a sleeper.
+* Linux only.
+*/
+#ifndef _PROCESS_OBJECTIVE
+#define _PROCESS_OBJECTIVE
+#if defined(__linux__)
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <mutex>
+#include <semaphore>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "papso2.h"
+
+namespace process_objective_detail
+{
+	static_assert(std::atomic<std::uint32_t>::is_always_lock_free
+		&& std::atomic<std::uint64_t>::is_always_lock_free, "atomics must be address free");
+
+	// Shared between processes, hence no FUTEX_PRIVATE_FLAG
+	inline void futex_wait(std::atomic<std::uint32_t>& word, std::uint32_t expected, const timespec* timeout = nullptr) noexcept {
+		syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT, expected, timeout, nullptr, 0);
+	}
+	inline void futex_wake(std::atomic<std::uint32_t>& word, int count) noexcept {
+		syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE, count, nullptr, nullptr, 0);
+	}
+
+	inline void cpu_relax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#endif
+	}
+
+	struct alignas(64) cursor {
+		std::atomic<std::uint64_t> pos{ 0 };
+	};
+
+	// Bounded MPMC ring over a shared mapping (Vyukov), every slot starts with its sequence number
+	class shared_ring {
+		std::byte* slots_ = nullptr;
+		std::size_t stride_ = 0;
+		std::uint64_t mask_ = 0;
+		cursor* enqueue_ = nullptr;
+		cursor* dequeue_ = nullptr;
+
+		std::atomic<std::uint64_t>& sequence(std::uint64_t pos) const noexcept {
+			return *reinterpret_cast<std::atomic<std::uint64_t>*>(slots_ + (pos & mask_) * stride_);
+		}
+		std::byte* payload(std::uint64_t pos) const noexcept {
+			return slots_ + (pos & mask_) * stride_ + header_size;
+		}
+
+	public:
+		static constexpr std::size_t header_size = 64;
+
+		shared_ring() = default;
+		shared_ring(std::byte* slots, std::size_t stride, std::size_t capacity, cursor* enqueue, cursor* dequeue) noexcept
+			: slots_(slots), stride_(stride), mask_(capacity - 1), enqueue_(enqueue), dequeue_(dequeue) {}
+
+		void initialize() noexcept {
+			for (std::uint64_t i = 0; i <= mask_; ++i) {
+				new (&sequence(i)) std::atomic<std::uint64_t>{ i };
+			}
+		}
+
+		bool empty() const noexcept {
+			for (;;) {
+				const auto pos = dequeue_->pos.load(std::memory_order_acquire);
+				const auto diff = static_cast<std::int64_t>(sequence(pos).load(std::memory_order_acquire) - (pos + 1));
+				if (diff <= 0) {
+					return diff < 0;
+				}
+				// Slot already taken, `pos` is stale
+			}
+		}
+
+		// `write(std::byte*)` fills the payload
+		template <typename Write>
+		bool try_push(Write&& write) noexcept {
+			auto pos = enqueue_->pos.load(std::memory_order_relaxed);
+			for (;;) {
+				const auto seq = sequence(pos).load(std::memory_order_acquire);
+				const auto diff = static_cast<std::int64_t>(seq - pos);
+				if (0 == diff) {
+					if (enqueue_->pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						break;
+					}
+				}
+				else if (diff < 0) {
+					return false; // Full
+				}
+				else {
+					pos = enqueue_->pos.load(std::memory_order_relaxed);
+				}
+			}
+			write(payload(pos));
+			sequence(pos).store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		// `read(const std::byte*)` consumes the payload
+		template <typename Read>
+		bool try_pop(Read&& read) noexcept {
+			auto pos = dequeue_->pos.load(std::memory_order_relaxed);
+			for (;;) {
+				const auto seq = sequence(pos).load(std::memory_order_acquire);
+				const auto diff = static_cast<std::int64_t>(seq - (pos + 1));
+				if (0 == diff) {
+					if (dequeue_->pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						break;
+					}
+				}
+				else if (diff < 0) {
+					return false; // Empty
+				}
+				else {
+					pos = dequeue_->pos.load(std::memory_order_relaxed);
+				}
+			}
+			read(static_cast<const std::byte*>(payload(pos)));
+			sequence(pos).store(pos + mask_ + 1, std::memory_order_release);
+			return true;
+		}
+	};
+}
+
+// async_objective evaluating `f` in `process_count` forked worker processes
+// Construct it before the executor so that the workers fork a single threaded parent
+// A worker that dies fails the evaluation it was running with `std::runtime_error`,
+// once none is left every pending and later evaluation fails alike
+class process_pool_objective : public async_objective {
+	using cursor = process_objective_detail::cursor;
+	using shared_ring = process_objective_detail::shared_ring;
+
+	// Head of the shared mapping
+	struct control_block {
+		cursor request_enqueue, request_dequeue;
+		cursor completion_enqueue, completion_dequeue;
+		alignas(64) std::atomic<std::uint32_t> request_signal{ 0 };
+		std::atomic<std::uint32_t> idle_workers{ 0 };
+		alignas(64) std::atomic<std::uint32_t> completion_signal{ 0 };
+		std::atomic<std::uint32_t> collector_idle{ 0 };
+		alignas(64) std::atomic<std::uint32_t> stop{ 0 };
+	};
+
+	struct completion_t {
+		std::uint32_t id;
+		std::uint32_t ticket;
+		double value;
+	};
+
+	// The request a worker is evaluating, ticket and id, zero when none
+	struct alignas(64) worker_slot {
+		std::atomic<std::uint64_t> busy{ 0 };
+	};
+
+	static constexpr unsigned spin_count = 1 << 6;
+
+	func_t f_;
+	std::size_t dimension_;
+	std::size_t capacity_;
+	std::size_t mapping_size_ = 0;
+	void* mapping_ = nullptr;
+	control_block* control_ = nullptr;
+	worker_slot* worker_slots_ = nullptr;
+	shared_ring requests_, completions_;
+	std::vector<pid_t> workers_; // -1 once reaped
+
+	// Parent side, a promise id travels with its request, with the ticket of the submission
+	std::vector<std::promise<double>> promises_;
+	std::mutex ids_mtx_;
+	std::vector<std::uint32_t> free_ids_;
+	std::vector<std::uint32_t> tickets_; // Last submitted, under `ids_mtx_`
+	std::vector<std::uint32_t> completed_tickets_; // Last completed, collector only
+	std::atomic<bool> broken_{ false }; // No worker left
+	std::counting_semaphore<> slots_;
+	std::atomic<std::uint32_t> unflushed_{ 0 };
+	std::thread collector_;
+
+	static std::size_t round_up(std::size_t bytes, std::size_t unit) noexcept {
+		return (bytes + unit - 1) / unit * unit;
+	}
+
+	// Park until `signal` moves, `idle` tells the other side to wake us
+	static void park(std::atomic<std::uint32_t>& signal, std::atomic<std::uint32_t>& idle
+		, const shared_ring& ring, const std::atomic<std::uint32_t>& stop, const timespec* timeout = nullptr) noexcept {
+		const auto expected = signal.load(std::memory_order_acquire);
+		idle.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (ring.empty() && !stop.load(std::memory_order_acquire)) {
+			process_objective_detail::futex_wait(signal, expected, timeout);
+		}
+		idle.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	static void signal(std::atomic<std::uint32_t>& signal, std::atomic<std::uint32_t>& idle, int count) noexcept {
+		signal.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (idle.load(std::memory_order_seq_cst)) {
+			process_objective_detail::futex_wake(signal, count);
+		}
+	}
+
+	[[noreturn]] void worker_main(vec_t& scratch, std::size_t index) noexcept {
+		prctl(PR_SET_PDEATHSIG, SIGKILL);
+		auto& ctl = *control_;
+		auto& busy = worker_slots_[index].busy;
+		unsigned idle_spins = 0;
+		while (!ctl.stop.load(std::memory_order_acquire)) {
+			std::uint32_t id = 0, ticket = 0;
+			// Copy out and release the slot before evaluating
+			const bool got = requests_.try_pop([&](const std::byte* payload) {
+				std::memcpy(&id, payload, sizeof(id));
+				std::memcpy(&ticket, payload + sizeof(id), sizeof(ticket));
+				std::memcpy(scratch.data(), payload + sizeof(double), dimension_ * sizeof(double));
+				busy.store(std::uint64_t{ ticket } << 32 | id, std::memory_order_release);
+			});
+			if (!got) {
+				if (++idle_spins < spin_count) {
+					process_objective_detail::cpu_relax();
+				}
+				else {
+					park(ctl.request_signal, ctl.idle_workers, requests_, ctl.stop);
+					idle_spins = 0;
+				}
+				continue;
+			}
+			idle_spins = 0;
+
+			const completion_t done{ id, ticket, f_(scratch.cbegin(), scratch.cend()) };
+			// Never full, at most `capacity_` requests are out
+			while (!completions_.try_push([&](std::byte* payload) { std::memcpy(payload, &done, sizeof(done)); })) {
+				process_objective_detail::cpu_relax();
+			}
+			busy.store(0, std::memory_order_release);
+			// Pairs with the fence in park(), the completion is visible before the check
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (ctl.collector_idle.load(std::memory_order_seq_cst)) {
+				signal(ctl.completion_signal, ctl.collector_idle, 1);
+			}
+		}
+		_exit(0);
+	}
+
+	// Fulfills the promises in the parent, a whole batch of completions per wakeup
+	// Parks no longer than `reap_interval` at a time, dead workers are looked for then
+	void collector_main() noexcept {
+		static constexpr timespec reap_interval{ 0, 10'000'000 };
+		auto& ctl = *control_;
+		unsigned idle_spins = 0;
+		std::vector<std::uint32_t> done_ids;
+		while (!ctl.stop.load(std::memory_order_acquire)) {
+			done_ids.clear();
+			collect(done_ids);
+
+			if (done_ids.empty()) {
+				if (++idle_spins < spin_count) {
+					process_objective_detail::cpu_relax();
+				}
+				else {
+					park(ctl.completion_signal, ctl.collector_idle, completions_, ctl.stop, &reap_interval);
+					idle_spins = 0;
+					reap(done_ids);
+				}
+			}
+			else {
+				idle_spins = 0;
+			}
+			release(done_ids);
+		}
+	}
+
+	void collect(std::vector<std::uint32_t>& done_ids) noexcept {
+		completion_t done;
+		while (completions_.try_pop([&](const std::byte* payload) { std::memcpy(&done, payload, sizeof(done)); })) {
+			promises_[done.id].set_value(done.value);
+			completed_tickets_[done.id] = done.ticket;
+			done_ids.push_back(done.id);
+		}
+	}
+
+	void fail(std::uint32_t id, std::vector<std::uint32_t>& done_ids) noexcept {
+		promises_[id].set_exception(std::make_exception_ptr(std::runtime_error("process_pool_objective: worker died")));
+		done_ids.push_back(id);
+	}
+
+	// Fails what dead workers were evaluating, after what they completed before dying.
+	// With no worker left, the requests nobody will take
+	void reap(std::vector<std::uint32_t>& done_ids) noexcept {
+		std::size_t alive = 0;
+		bool died = false;
+		for (pid_t& pid : workers_) {
+			if (pid > 0 && pid == waitpid(pid, nullptr, WNOHANG)) {
+				pid = -1;
+				died = true;
+			}
+			alive += pid > 0;
+		}
+		if (died) {
+			collect(done_ids); // Nothing more comes from the dead
+			for (std::size_t w = 0; w < workers_.size(); ++w) {
+				const auto busy = worker_slots_[w].busy.load(std::memory_order_acquire);
+				if (workers_[w] < 0 && busy) {
+					worker_slots_[w].busy.store(0, std::memory_order_relaxed);
+					const auto id = static_cast<std::uint32_t>(busy);
+					if (completed_tickets_[id] != static_cast<std::uint32_t>(busy >> 32)) {
+						fail(id, done_ids);
+					}
+				}
+			}
+		}
+		if (0 == alive) {
+			broken_.store(true, std::memory_order_release);
+			std::uint32_t id;
+			while (requests_.try_pop([&](const std::byte* payload) { std::memcpy(&id, payload, sizeof(id)); })) {
+				fail(id, done_ids);
+			}
+		}
+	}
+
+	void release(const std::vector<std::uint32_t>& done_ids) {
+		if (done_ids.empty()) {
+			return;
+		}
+		{
+			std::lock_guard guard{ ids_mtx_ };
+			free_ids_.insert(free_ids_.end(), done_ids.begin(), done_ids.end());
+		}
+		slots_.release(static_cast<std::ptrdiff_t>(done_ids.size()));
+	}
+
+	void shutdown() noexcept {
+		if (!control_) {
+			return;
+		}
+		control_->stop.store(1, std::memory_order_release);
+		control_->request_signal.fetch_add(1);
+		process_objective_detail::futex_wake(control_->request_signal, std::numeric_limits<int>::max());
+		control_->completion_signal.fetch_add(1);
+		process_objective_detail::futex_wake(control_->completion_signal, 1);
+		if (collector_.joinable()) {
+			collector_.join();
+		}
+		for (pid_t pid : workers_) {
+			if (pid > 0) {
+				waitpid(pid, nullptr, 0);
+			}
+		}
+		munmap(mapping_, mapping_size_);
+		control_ = nullptr;
+	}
+
+public:
+	// `capacity` bounds the evaluations in flight and is rounded up to a power of two
+	process_pool_objective(func_t f, std::size_t dimension, std::size_t process_count, std::size_t capacity = 256)
+		: f_(f)
+		, dimension_(dimension)
+		, capacity_(std::bit_ceil(std::max<std::size_t>(capacity, 2)))
+		, promises_(capacity_)
+		, slots_(static_cast<std::ptrdiff_t>(capacity_))
+	{
+		// [control][worker slots][request slots: id, ticket, position][completion slots]
+		const std::size_t request_stride = round_up(shared_ring::header_size + sizeof(double) * (1 + dimension_), 64);
+		const std::size_t completion_stride = round_up(shared_ring::header_size + sizeof(completion_t), 64);
+		const std::size_t control_size = round_up(sizeof(control_block), 64) + process_count * sizeof(worker_slot);
+		mapping_size_ = control_size + capacity_ * (request_stride + completion_stride);
+		mapping_ = mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (MAP_FAILED == mapping_) {
+			throw std::system_error(errno, std::generic_category(), "mmap");
+		}
+
+		auto* base = static_cast<std::byte*>(mapping_);
+		control_ = new (base) control_block{};
+		worker_slots_ = new (base + round_up(sizeof(control_block), 64)) worker_slot[process_count]{};
+		requests_ = shared_ring(base + control_size, request_stride, capacity_
+			, &control_->request_enqueue, &control_->request_dequeue);
+		completions_ = shared_ring(base + control_size + capacity_ * request_stride, completion_stride, capacity_
+			, &control_->completion_enqueue, &control_->completion_dequeue);
+		requests_.initialize();
+		completions_.initialize();
+
+		tickets_.assign(capacity_, 0);
+		completed_tickets_.assign(capacity_, 0);
+		free_ids_.resize(capacity_);
+		for (std::uint32_t i = 0; i < capacity_; ++i) {
+			free_ids_[i] = static_cast<std::uint32_t>(capacity_ - 1 - i);
+		}
+
+		// Allocated before forking, every worker inherits its own copy
+		vec_t scratch(dimension_);
+		workers_.reserve(process_count);
+		for (std::size_t i = 0; i < process_count; ++i) {
+			const pid_t pid = fork();
+			if (0 == pid) {
+				worker_main(scratch, i);
+			}
+			if (pid < 0) {
+				const int err = errno;
+				shutdown();
+				throw std::system_error(err, std::generic_category(), "fork");
+			}
+			workers_.push_back(pid);
+		}
+		collector_ = std::thread([this]() { collector_main(); });
+	}
+	process_pool_objective(const process_pool_objective&) = delete;
+	~process_pool_objective() override {
+		shutdown();
+	}
+
+	// Copies the position into a request slot, blocks only when `capacity` evaluations are out
+	// A position of another dimension, or no worker left, fails the evaluation right away
+	std::future<double> submit(iter beg, iter end) override {
+		if (static_cast<std::size_t>(end - beg) != dimension_ || broken_.load(std::memory_order_acquire)) {
+			std::promise<double> failed;
+			failed.set_exception(std::make_exception_ptr(static_cast<std::size_t>(end - beg) != dimension_
+				? std::runtime_error("process_pool_objective: wrong dimension")
+				: std::runtime_error("process_pool_objective: no worker left")));
+			return failed.get_future();
+		}
+		slots_.acquire();
+		std::uint32_t id, ticket;
+		{
+			std::lock_guard guard{ ids_mtx_ };
+			id = free_ids_.back();
+			free_ids_.pop_back();
+			ticket = ++tickets_[id];
+		}
+		promises_[id] = std::promise<double>{};
+		auto fut = promises_[id].get_future();
+
+		// A request pushed after the collector gave up on the workers is failed by its next pass
+		while (!requests_.try_push([&](std::byte* payload) {
+			std::memcpy(payload, &id, sizeof(id));
+			std::memcpy(payload + sizeof(id), &ticket, sizeof(ticket));
+			std::memcpy(payload + sizeof(double), &*beg, dimension_ * sizeof(double));
+		})) {
+			process_objective_detail::cpu_relax();
+		}
+		unflushed_.fetch_add(1, std::memory_order_relaxed);
+		return fut;
+	}
+
+	// Wakes as many sleeping workers as there are new requests, one syscall per batch at most
+	void flush() override {
+		const auto batch = unflushed_.exchange(0, std::memory_order_relaxed);
+		if (batch) {
+			signal(control_->request_signal, control_->idle_workers, static_cast<int>(batch));
+		}
+	}
+
+	std::size_t process_count() const noexcept { return workers_.size(); }
+};
+
+#endif
+#endif
@@ -0,0 +1,152 @@
+/*
+* Island migration between processes on one host
+* A named POSIX shared memory segment holds an outbox per process, `migrants` slots
+* each. Every slot is written by its process only and guarded by a seqlock, a migrant
+* is copied into the slot, out of it into a scratch, and into the reader's position
+* once the seqlock says the copy is whole.
+* Processes form a ring: process i takes its migrants from process i - 1.
+* Linux only.
+*/
+#ifndef _SHM_MIGRATION
+#define _SHM_MIGRATION
+#if defined(__linux__)
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "papso2.h"
+
+class shm_migration : public migration_channel {
+	static_assert(std::atomic<std::uint64_t>::is_always_lock_free
+		&& std::atomic<double>::is_always_lock_free, "atomics must be address free");
+
+	struct alignas(64) segment_header {
+		std::atomic<std::uint64_t> shape; // Set by the first process to attach
+	};
+	struct alignas(64) slot_header {
+		std::atomic<std::uint64_t> version; // Odd while written, zero until first written
+		std::atomic<double> value;
+	};
+
+	std::size_t process_index_;
+	std::size_t process_count_;
+	std::size_t dimension_;
+	std::size_t migrants_;
+	std::size_t stride_; // Slot header and position, whole cache lines
+	std::size_t size_;
+	int fd_ = -1;
+	std::byte* mapping_ = nullptr;
+
+	slot_header& slot(std::size_t process, std::size_t r) const noexcept {
+		return *reinterpret_cast<slot_header*>(mapping_ + sizeof(segment_header) + (process * migrants_ + r) * stride_);
+	}
+	static double* position(slot_header& s) noexcept {
+		return reinterpret_cast<double*>(reinterpret_cast<std::byte*>(&s) + sizeof(slot_header));
+	}
+
+public:
+	// Every process of the ring attaches to the same `name` with the same shape and its own index
+	// The segment outlives the processes: `remove` it before a new ring starts, not to take in old migrants
+	shm_migration(const char* name, std::size_t process_index, std::size_t process_count
+		, std::size_t dimension, std::size_t migrants = 2)
+		: process_index_(process_index), process_count_(process_count), dimension_(dimension)
+		, migrants_(migrants)
+		, stride_(sizeof(slot_header) + (dimension * sizeof(double) + 63) / 64 * 64)
+		, size_(sizeof(segment_header) + process_count * migrants * stride_)
+	{
+		if (process_index >= process_count || 0 == migrants || dimension >= (1ull << 32)
+			|| process_count >= (1ull << 16) || migrants >= (1ull << 16)) {
+			throw std::invalid_argument("shm_migration: bad shape");
+		}
+		fd_ = shm_open(name, O_CREAT | O_RDWR, 0600);
+		if (fd_ < 0) {
+			throw std::system_error(errno, std::generic_category(), "shm_open");
+		}
+		// Same size from every process, new pages read as zero
+		if (ftruncate(fd_, static_cast<off_t>(size_)) < 0) {
+			const int err = errno;
+			close(fd_);
+			throw std::system_error(err, std::generic_category(), "ftruncate");
+		}
+		void* mapping = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+		if (MAP_FAILED == mapping) {
+			const int err = errno;
+			close(fd_);
+			throw std::system_error(err, std::generic_category(), "mmap");
+		}
+		mapping_ = static_cast<std::byte*>(mapping);
+
+		const std::uint64_t shape = (static_cast<std::uint64_t>(dimension) << 32)
+			| (static_cast<std::uint64_t>(process_count) << 16) | migrants;
+		auto& header = *reinterpret_cast<segment_header*>(mapping_);
+		std::uint64_t expected = 0;
+		if (!header.shape.compare_exchange_strong(expected, shape, std::memory_order_acq_rel)
+			&& expected != shape) {
+			munmap(mapping_, size_);
+			close(fd_);
+			throw std::invalid_argument("shm_migration: segment attached with another shape");
+		}
+	}
+	shm_migration(const shm_migration&) = delete;
+	~shm_migration() {
+		munmap(mapping_, size_);
+		close(fd_);
+	}
+
+	static void remove(const char* name) noexcept {
+		shm_unlink(name);
+	}
+
+	std::size_t process_index() const noexcept { return process_index_; }
+	std::size_t process_count() const noexcept { return process_count_; }
+	std::size_t migrants() const noexcept override { return migrants_; }
+
+	void emigrate(std::size_t r, const double* x, double value) noexcept override {
+		slot_header& s = slot(process_index_, r);
+		const auto v = s.version.load(std::memory_order_relaxed);
+		s.version.store(v + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		std::memcpy(position(s), x, dimension_ * sizeof(double));
+		s.value.store(value, std::memory_order_relaxed);
+		s.version.store(v + 2, std::memory_order_release);
+	}
+
+	// A copy torn by a concurrent write is retried a few times, after that false is returned
+	// `x` is only written with a whole migrant
+	bool immigrate(std::size_t r, double better_than, double* x, double& value) noexcept override {
+		thread_local std::vector<double> scratch;
+		slot_header& s = slot((process_index_ + process_count_ - 1) % process_count_, r);
+		for (int attempt = 0; attempt < 4; ++attempt) {
+			const auto v = s.version.load(std::memory_order_acquire);
+			if (0 == v) {
+				return false; // Nothing offered yet
+			}
+			if (v & 1) {
+				continue;
+			}
+			const double published = s.value.load(std::memory_order_relaxed);
+			if (!(published < better_than)) {
+				return false;
+			}
+			scratch.resize(dimension_);
+			std::memcpy(scratch.data(), position(s), dimension_ * sizeof(double));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (s.version.load(std::memory_order_relaxed) == v) {
+				std::memcpy(x, scratch.data(), dimension_ * sizeof(double));
+				value = published;
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+#endif
+#endif
@@ -0,0 +1,92 @@
+/*
+* Asynchronous objectives for benchmarking
+* Stand-ins for external simulators: a result comes back after a latency
+* during which no worker thread is busy.
+*/
+#ifndef _SIMULATED_OBJECTIVE
+#define _SIMULATED_OBJECTIVE
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "papso2.h"
+
+// Computes `f` at submission and completes the future `latency` later from a timer thread
+class simulated_latency_objective : public async_objective {
+	using clock_t = std::chrono::steady_clock;
+	struct pending_t {
+		clock_t::time_point deadline;
+		double value;
+		mutable std::promise<double> promise;
+
+		bool operator>(const pending_t& rhs) const noexcept {
+			return deadline > rhs.deadline;
+		}
+	};
+
+	func_t f_;
+	clock_t::duration latency_;
+	std::mutex mtx_;
+	std::condition_variable_any cv_;
+	std::priority_queue<pending_t, std::vector<pending_t>, std::greater<>> pending_;
+	std::jthread timer_;
+
+	void timer_main(std::stop_token stoken) {
+		std::unique_lock lock{ mtx_ };
+		while (!stoken.stop_requested()) {
+			if (pending_.empty()) {
+				cv_.wait(lock, stoken, [&]() { return !pending_.empty(); });
+				continue;
+			}
+
+			const auto deadline = pending_.top().deadline;
+			if (clock_t::now() < deadline) {
+				// Woken early by an earlier deadline or a stop request
+				cv_.wait_until(lock, stoken, deadline, [&]() { return pending_.top().deadline < deadline; });
+				continue;
+			}
+
+			std::promise<double> promise = std::move(pending_.top().promise);
+			const double value = pending_.top().value;
+			pending_.pop();
+			lock.unlock();
+			promise.set_value(value);
+			lock.lock();
+		}
+	}
+
+public:
+	simulated_latency_objective(func_t f, std::chrono::microseconds latency)
+		: f_(f), latency_(latency)
+		, timer_([this](std::stop_token stoken) { timer_main(stoken); }) {}
+	simulated_latency_objective(const simulated_latency_objective&) = delete;
+	~simulated_latency_objective() override {
+		timer_.request_stop();
+		timer_.join();
+	}
+
+	std::future<double> submit(iter beg, iter end) override {
+		pending_t p{ clock_t::now() + latency_, f_(beg, end), {} };
+		auto fut = p.promise.get_future();
+		{
+			std::lock_guard guard{ mtx_ };
+			pending_.push(std::move(p));
+		}
+		cv_.notify_one();
+		return fut;
+	}
+};
+
+// Same latency, but blocking the calling thread, as a plain `func_t` would
+template <func_t F, std::size_t LatencyUs>
+struct blocking_latency_objective {
+	static double function(iter beg, iter end) {
+		std::this_thread::sleep_for(std::chrono::microseconds{ LatencyUs });
+		return F(beg, end);
+	}
+};
+
+#endif
@@ -0,0 +1,144 @@
+/*
+* Best solutions of past runs, keyed by problem ID, kept in a file
+* Runs of a problem seen before start around what was found then (see `papso_options::archive`).
+* Every problem keeps its `per_problem` best distinct positions. The file is binary:
+* records of ID length, ID, value, dimension and position, read whole on construction
+* and rewritten whole by `save`, through a temporary file renamed over it.
+*/
+#ifndef _SOLUTION_ARCHIVE
+#define _SOLUTION_ARCHIVE
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class solution_archive {
+public:
+	struct entry {
+		double value;
+		std::vector<double> position;
+	};
+
+private:
+	std::string path_;
+	std::size_t per_problem_;
+	mutable std::mutex mtx_;
+	std::map<std::string, std::vector<entry>, std::less<>> entries_; // Best first
+	bool dirty_ = false;
+
+	template <typename T>
+	static bool read(std::ifstream& in, T& value) {
+		return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+	template <typename T>
+	static void write(std::ofstream& out, const T& value) {
+		out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	void load() {
+		std::ifstream in(path_, std::ios::binary);
+		std::uint32_t id_size;
+		while (in && read(in, id_size) && id_size <= 4096) {
+			std::string id(id_size, '\0');
+			double value;
+			std::uint64_t dimension;
+			if (!in.read(id.data(), id_size) || !read(in, value) || !read(in, dimension)
+				|| dimension > (std::uint64_t{ 1 } << 24)) {
+				break; // Truncated, keep what was read
+			}
+			std::vector<double> position(dimension);
+			if (!in.read(reinterpret_cast<char*>(position.data()), dimension * sizeof(double))) {
+				break;
+			}
+			insert(id, value, std::move(position));
+		}
+	}
+
+	void insert(std::string_view id, double value, std::vector<double> position) {
+		auto it = entries_.find(id);
+		if (it == entries_.end()) {
+			it = entries_.emplace(std::string(id), std::vector<entry>{}).first;
+		}
+		std::vector<entry>& best = it->second;
+		if (std::any_of(best.begin(), best.end(), [&](const entry& e) { return e.position == position; })) {
+			return;
+		}
+		if (best.size() >= per_problem_ && !(value < best.back().value)) {
+			return;
+		}
+		const auto at = std::upper_bound(best.begin(), best.end(), value
+			, [](double v, const entry& e) { return v < e.value; });
+		best.insert(at, entry{ value, std::move(position) });
+		if (best.size() > per_problem_) {
+			best.pop_back();
+		}
+	}
+
+public:
+	// Reads `path` if it exists, a missing file is an empty archive
+	explicit solution_archive(std::string path, std::size_t per_problem = 8)
+		: path_(std::move(path)), per_problem_(std::max<std::size_t>(per_problem, 1)) {
+		load();
+	}
+	solution_archive(const solution_archive&) = delete;
+	~solution_archive() {
+		save();
+	}
+
+	// Best first, positions of another dimension are left out
+	std::vector<std::vector<double>> seeds(std::string_view id, std::size_t dimension) const {
+		std::lock_guard guard{ mtx_ };
+		std::vector<std::vector<double>> positions;
+		const auto it = entries_.find(id);
+		if (it != entries_.end()) {
+			for (const entry& e : it->second) {
+				if (e.position.size() == dimension) {
+					positions.push_back(e.position);
+				}
+			}
+		}
+		return positions;
+	}
+
+	void record(std::string_view id, double value, std::vector<double> position) {
+		std::lock_guard guard{ mtx_ };
+		insert(id, value, std::move(position));
+		dirty_ = true;
+	}
+
+	// Nothing is written unless something was recorded, false when writing failed
+	bool save() {
+		std::lock_guard guard{ mtx_ };
+		if (!dirty_) {
+			return true;
+		}
+		const std::string temporary = path_ + ".tmp";
+		{
+			std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+			for (const auto& [id, best] : entries_) {
+				for (const entry& e : best) {
+					write(out, static_cast<std::uint32_t>(id.size()));
+					out.write(id.data(), id.size());
+					write(out, e.value);
+					write(out, static_cast<std::uint64_t>(e.position.size()));
+					out.write(reinterpret_cast<const char*>(e.position.data()), e.position.size() * sizeof(double));
+				}
+			}
+			if (!out) {
+				return false;
+			}
+		}
+		std::error_code ec;
+		std::filesystem::rename(temporary, path_, ec);
+		dirty_ = static_cast<bool>(ec);
+		return !dirty_;
+	}
+};
+
+#endif
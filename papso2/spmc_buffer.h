@@ -98,6 +98,9 @@ namespace hungbiu {
 		};
 	
 	public:
+		using value_type = T;
+		static constexpr size_t associativity = Associativity;
+
 		class viewer {
 			const T* pval_;
 			read_lock rlock_;
@@ -218,11 +221,23 @@ namespace hungbiu {
 		template <typename U>
 		void add_pending_write(U&& val, T* ptr) {			
 			T* pnew = ptr 
-						? new(ptr) T(std::forward<U>(val))  // Construct in-place
+						? &(*ptr = std::forward<U>(val))  // Reuse the retrieved value
 						: new T(std::forward<U>(val));		// Allocate to construct
 			T* pold = pending_value_.exchange(pnew, std::memory_order_acq_rel);
 		}
 
+		template <typename It>
+		void add_pending_write(It first, It last, T* ptr) {
+			T* pnew = ptr;
+			if (pnew) {
+				pnew->assign(first, last); // Reuse the retrieved value's storage
+			}
+			else {
+				pnew = new T(first, last);
+			}
+			T* pold = pending_value_.exchange(pnew, std::memory_order_acq_rel);
+		}
+
 		// if (buffer[read_idx + 1].count == 0 && pending_update) 
 		//		if (lock(write)) 
 		//			write buffer
@@ -272,7 +287,7 @@ namespace hungbiu {
 		spmc_buffer(spmc_buffer&& oth) noexcept {
 			auto p = oth.pending_value_.exchange(nullptr);
 			if (!p) {
-				auto idx = oth.read_index_.load();
+				auto idx = oth.read_index_.load() % Associativity;
 				slot_type& slot = oth.buffers_[idx];
 				counter_type* pc = &(slot.counter);
 				write_lock wlock_oth{ &oth, pc, idx };
@@ -321,11 +336,37 @@ namespace hungbiu {
 				write_idx = wlock.write_idx();
 				buffers_[write_idx].value = std::forward<U>(val);
 			}
+			delete old; // Superseded by this write
 			
 			// Publish new value
 			read_index_.store(write_idx, std::memory_order_release);
 		}
 
+		// Single writer, copy [first, last) into the slot's existing storage
+		// so that a slot holding a container allocates only on its first write
+		template <typename It>
+		void put(It first, It last) {
+			T* old = pending_value_.load(std::memory_order_acquire);
+			if (old) {
+				old = pending_value_.exchange(nullptr);
+			}
+
+			size_t write_idx = 0;
+			{
+				write_lock wlock = get_write_lock();
+				if (!wlock) {
+					add_pending_write(first, last, old);
+					return;
+				}
+				write_idx = wlock.write_idx();
+				buffers_[write_idx].value.assign(first, last);
+			}
+			delete old;
+
+			// Publish new value
+			read_index_.store(write_idx, std::memory_order_release);
+		}
+
 		viewer get() noexcept {
 			auto [pcounter, pval] = acquire_read();
 			read_lock rlock = { this, pcounter };
@@ -339,6 +380,9 @@ namespace hungbiu {
 		std::shared_mutex smtx_ alignas(64) = {};
 		T val_ alignas(64) = {};
 	public:
+		using value_type = T;
+		static constexpr size_t associativity = 1;
+
 		class viewer {
 			std::shared_lock<std::shared_mutex> slock_;
 			const T* pv_;
@@ -378,6 +422,11 @@ namespace hungbiu {
 			std::lock_guard guard{ smtx_ };
 			val_ = std::forward<U>(val);
 		}
+		template <typename It>
+		void put(It first, It last) {
+			std::lock_guard guard{ smtx_ };
+			val_.assign(first, last);
+		}
 	};
 }
 #endif 
\ No newline at end of file
@@ -0,0 +1,174 @@
+/*
+* Cheap stand-in for a costly objective
+* k nearest neighbours over the most recent evaluated samples, weighted by
+* inverse distance. Forks add samples as they evaluate, a rebuild folds them into
+* an immutable snapshot that predictions read without locking.
+*/
+#ifndef _SURROGATE_MODEL
+#define _SURROGATE_MODEL
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class knn_surrogate {
+	struct snapshot {
+		std::size_t count = 0;
+		std::vector<double> positions; // `count` rows of `dimension`
+		std::vector<double> values;
+		double spread = 0; // Standard deviation of `values`
+	};
+
+	std::size_t dimension_;
+	std::size_t k_;
+	std::size_t capacity_;
+	std::size_t min_samples_;
+	std::size_t rebuild_interval_;
+
+	// Added since the last rebuild
+	std::mutex pending_mtx_;
+	std::vector<double> pending_positions_;
+	std::vector<double> pending_values_;
+	std::atomic<std::size_t> pending_count_{ 0 };
+
+	// Ring of the latest `capacity` samples, touched by the rebuilding thread only
+	std::atomic<bool> rebuilding_{ false };
+	std::vector<double> archive_positions_;
+	std::vector<double> archive_values_;
+	std::size_t archive_next_ = 0;
+
+	std::atomic<std::shared_ptr<const snapshot>> snapshot_;
+
+public:
+	// Bounds `k`, so that a prediction keeps its neighbours on the stack
+	static constexpr std::size_t max_k = 32;
+
+	knn_surrogate(std::size_t dimension, std::size_t k = 8, std::size_t capacity = 2048
+		, std::size_t min_samples = 64, std::size_t rebuild_interval = 64)
+		: dimension_(dimension), k_(std::clamp<std::size_t>(k, 1, max_k)), capacity_(std::max(capacity, k_))
+		, min_samples_(std::max(min_samples, k_)), rebuild_interval_(std::max<std::size_t>(rebuild_interval, 1))
+		, snapshot_(std::make_shared<const snapshot>()) {}
+	knn_surrogate(const knn_surrogate&) = delete;
+
+	std::size_t dimension() const noexcept { return dimension_; }
+
+	template <typename T>
+	void add(const T* position, double value) {
+		std::lock_guard guard{ pending_mtx_ };
+		pending_positions_.insert(pending_positions_.end(), position, position + dimension_);
+		pending_values_.push_back(value);
+		pending_count_.store(pending_values_.size(), std::memory_order_relaxed);
+	}
+
+	// True for one caller once enough samples are pending, that caller must rebuild()
+	bool claim_rebuild() noexcept {
+		if (pending_count_.load(std::memory_order_relaxed) < rebuild_interval_
+			|| rebuilding_.load(std::memory_order_relaxed)) {
+			return false;
+		}
+		return !rebuilding_.exchange(true, std::memory_order_acquire);
+	}
+
+	void rebuild() {
+		std::vector<double> positions, values;
+		{
+			std::lock_guard guard{ pending_mtx_ };
+			positions.swap(pending_positions_);
+			values.swap(pending_values_);
+			pending_count_.store(0, std::memory_order_relaxed);
+		}
+
+		for (std::size_t i = 0; i < values.size(); ++i) {
+			if (archive_values_.size() < capacity_) {
+				archive_positions_.insert(archive_positions_.end()
+					, positions.begin() + i * dimension_, positions.begin() + (i + 1) * dimension_);
+				archive_values_.push_back(values[i]);
+				continue;
+			}
+			std::copy_n(positions.begin() + i * dimension_, dimension_
+				, archive_positions_.begin() + archive_next_ * dimension_);
+			archive_values_[archive_next_] = values[i];
+			archive_next_ = (archive_next_ + 1) % capacity_;
+		}
+
+		auto s = std::make_shared<snapshot>();
+		s->count = archive_values_.size();
+		s->positions = archive_positions_;
+		s->values = archive_values_;
+		if (s->count) {
+			double mean = 0, square = 0;
+			for (double v : s->values) {
+				mean += v;
+				square += v * v;
+			}
+			mean /= s->count;
+			s->spread = std::sqrt(std::max(0., square / s->count - mean * mean));
+		}
+		snapshot_.store(std::move(s), std::memory_order_release);
+		rebuilding_.store(false, std::memory_order_release);
+	}
+
+	// False until `min_samples` have been folded in
+	template <typename T>
+	bool predict(const T* position, double& value, double& spread) const {
+		const std::shared_ptr<const snapshot> s = snapshot_.load(std::memory_order_acquire);
+		if (s->count < min_samples_) {
+			return false;
+		}
+
+		// k smallest distances, kept sorted
+		std::array<std::pair<double, double>, max_k> buffer;
+		const auto nearest_begin = buffer.begin(), nearest_end = buffer.begin() + k_;
+		std::fill(nearest_begin, nearest_end, std::pair{ std::numeric_limits<double>::max(), 0. });
+		const double* row = s->positions.data();
+		for (std::size_t i = 0; i < s->count; ++i, row += dimension_) {
+			double d2 = 0;
+			for (std::size_t j = 0; j < dimension_; ++j) {
+				const double d = row[j] - position[j];
+				d2 += d * d;
+			}
+			if (d2 < (nearest_end - 1)->first) {
+				auto it = std::upper_bound(nearest_begin, nearest_end, d2
+					, [](double d, const std::pair<double, double>& n) { return d < n.first; });
+				std::move_backward(it, nearest_end - 1, nearest_end);
+				*it = { d2, s->values[i] };
+			}
+		}
+
+		if (0 == nearest_begin->first) {
+			value = nearest_begin->second;
+		}
+		else {
+			double weights = 0, sum = 0;
+			for (auto it = nearest_begin; it != nearest_end; ++it) {
+				const double w = 1. / it->first;
+				weights += w;
+				sum += w * it->second;
+			}
+			value = sum / weights;
+		}
+		spread = s->spread;
+		return true;
+	}
+
+	// Forget every sample, not while a run uses it
+	void clear() {
+		{
+			std::lock_guard guard{ pending_mtx_ };
+			pending_positions_.clear();
+			pending_values_.clear();
+			pending_count_.store(0, std::memory_order_relaxed);
+		}
+		archive_positions_.clear();
+		archive_values_.clear();
+		archive_next_ = 0;
+		snapshot_.store(std::make_shared<const snapshot>(), std::memory_order_release);
+	}
+};
+
+#endif
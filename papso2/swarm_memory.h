@@ -0,0 +1,207 @@
+/*
+* Memory backing of large swarms
+* Huge pages cut TLB misses on the big arrays, NUMA binding keeps
+* a subswarm's pages on the node of the worker owning it.
+* Every request degrades to the standard allocation when refused by the OS.
+*/
+#ifndef _SWARM_MEMORY
+#define _SWARM_MEMORY
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_MSC_VER)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+namespace hungbiu
+{
+	enum class memory_policy {
+		standard,	// operator new
+		huge_pages,	// explicit huge pages, transparent huge pages otherwise
+	};
+
+	namespace swarm_memory
+	{
+		static constexpr std::size_t page_size = 4096;
+		static constexpr std::size_t huge_page_size = std::size_t{ 2 } << 20;
+
+		// Smaller blocks are not worth a mapping of their own
+		static constexpr std::size_t huge_page_threshold = huge_page_size / 2;
+
+		inline std::size_t round_up(std::size_t bytes, std::size_t unit) noexcept {
+			return (bytes + unit - 1) / unit * unit;
+		}
+
+		// Returns nullptr when nothing could be mapped
+		inline void* map_huge(std::size_t bytes) noexcept {
+			bytes = round_up(bytes, huge_page_size);
+#if defined(__linux__)
+			void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE
+				, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (MAP_FAILED != p) {
+				return p;
+			}
+
+			// No reserved huge pages, ask for transparent ones
+			p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE
+				, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (MAP_FAILED == p) {
+				return nullptr;
+			}
+#ifdef MADV_HUGEPAGE
+			madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+			return p;
+#elif defined(_MSC_VER)
+			// Needs SeLockMemoryPrivilege
+			const std::size_t large = GetLargePageMinimum();
+			if (large) {
+				void* p = VirtualAlloc(nullptr, round_up(bytes, large)
+					, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+				if (p) {
+					return p;
+				}
+			}
+			return VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+			return nullptr;
+#endif
+		}
+
+		inline void unmap_huge(void* p, std::size_t bytes) noexcept {
+#if defined(__linux__)
+			munmap(p, round_up(bytes, huge_page_size));
+#elif defined(_MSC_VER)
+			VirtualFree(p, 0, MEM_RELEASE);
+#endif
+		}
+
+		// Ask for transparent huge pages on memory that has not been touched yet,
+		// only whole huge pages inside [p, p + bytes) are affected
+		inline bool advise_huge_pages(void* p, std::size_t bytes) noexcept {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+			auto first = round_up(reinterpret_cast<std::uintptr_t>(p), huge_page_size);
+			auto last = (reinterpret_cast<std::uintptr_t>(p) + bytes) / huge_page_size * huge_page_size;
+			if (first >= last) {
+				return false;
+			}
+			return 0 == madvise(reinterpret_cast<void*>(first), last - first, MADV_HUGEPAGE);
+#else
+			return false;
+#endif
+		}
+
+		// NUMA node of the calling thread, -1 if unknown
+		inline int current_node() noexcept {
+#if defined(__linux__) && defined(SYS_getcpu)
+			unsigned cpu = 0, node = 0;
+			if (0 == syscall(SYS_getcpu, &cpu, &node, nullptr)) {
+				return static_cast<int>(node);
+			}
+#endif
+			return -1;
+		}
+
+		// Bytes from `p` to the next multiple of `unit`
+		inline std::size_t align_offset(const void* p, std::size_t unit) noexcept {
+			const auto address = reinterpret_cast<std::uintptr_t>(p);
+			return static_cast<std::size_t>(round_up(address, unit) - address);
+		}
+
+		// Prefer `node` for the pages of [p, p + bytes), moving those already touched
+		// Only whole pages inside the range are affected, the neighbors of a block keep their policy
+		// Raw syscall so that libnuma is not required
+		inline bool bind_to_node(void* p, std::size_t bytes, int node) noexcept {
+#if defined(__linux__) && defined(SYS_mbind)
+			static constexpr int MPOL_PREFERRED_ = 1;
+			static constexpr unsigned MPOL_MF_MOVE_ = 1u << 1;
+			if (node < 0 || node >= 64) {
+				return false;
+			}
+
+			auto first = round_up(reinterpret_cast<std::uintptr_t>(p), page_size);
+			auto last = (reinterpret_cast<std::uintptr_t>(p) + bytes) / page_size * page_size;
+			if (first >= last) {
+				return false;
+			}
+			unsigned long mask = 1ul << node;
+			return 0 == syscall(SYS_mbind, first, last - first, MPOL_PREFERRED_
+				, &mask, sizeof(mask) * 8, MPOL_MF_MOVE_);
+#else
+			return false;
+#endif
+		}
+	}
+
+	// Stateful allocator choosing the backing by its policy
+	// Large blocks under `huge_pages` get a mapping of their own, or come from
+	// operator new when the OS refuses one. Mappings start on a page, such a block
+	// starts `heap_offset` past one, which is how it is told apart when deallocated
+	template <typename T>
+	class swarm_allocator {
+		template <typename U> friend class swarm_allocator;
+		memory_policy policy_;
+
+		static constexpr std::size_t heap_offset = alignof(T) > 64 ? alignof(T) : 64;
+		static_assert(heap_offset < swarm_memory::page_size);
+
+		bool use_mapping(std::size_t bytes) const noexcept {
+			return memory_policy::huge_pages == policy_
+				&& bytes >= swarm_memory::huge_page_threshold;
+		}
+	public:
+		using value_type = T;
+		using propagate_on_container_move_assignment = std::true_type;
+		using propagate_on_container_swap = std::true_type;
+
+		swarm_allocator(memory_policy policy = memory_policy::standard) noexcept
+			: policy_(policy) {}
+		template <typename U>
+		swarm_allocator(const swarm_allocator<U>& oth) noexcept
+			: policy_(oth.policy_) {}
+
+		memory_policy policy() const noexcept { return policy_; }
+
+		T* allocate(std::size_t n) {
+			const std::size_t bytes = n * sizeof(T);
+			if (use_mapping(bytes)) {
+				if (void* p = swarm_memory::map_huge(bytes)) {
+					return static_cast<T*>(p);
+				}
+				auto* p = static_cast<std::byte*>(::operator new(bytes + heap_offset
+					, std::align_val_t{ swarm_memory::page_size }));
+				return reinterpret_cast<T*>(p + heap_offset);
+			}
+			return static_cast<T*>(::operator new(bytes, std::align_val_t{ alignof(T) }));
+		}
+		void deallocate(T* p, std::size_t n) noexcept {
+			const std::size_t bytes = n * sizeof(T);
+			if (use_mapping(bytes)) {
+				if (0 == swarm_memory::align_offset(p, swarm_memory::page_size)) {
+					swarm_memory::unmap_huge(p, bytes);
+				}
+				else {
+					::operator delete(reinterpret_cast<std::byte*>(p) - heap_offset
+						, std::align_val_t{ swarm_memory::page_size });
+				}
+				return;
+			}
+			::operator delete(p, std::align_val_t{ alignof(T) });
+		}
+
+		template <typename U>
+		bool operator==(const swarm_allocator<U>& rhs) const noexcept {
+			return policy_ == rhs.policy_;
+		}
+	};
+}
+
+#endif
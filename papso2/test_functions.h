@@ -120,6 +120,24 @@ struct test_functions {
 
 	// f9
 
+	// Per-dimension terms of the separable ones, f(x) = finalize(sum of terms)
+	// Not griewank, its product does not decompose into a sum
+	static double sphere_term(std::size_t, double x) {
+		return std::pow(x, 2);
+	}
+
+	static double schwefel_26_term(std::size_t, double x) {
+		return x * std::sin(std::sqrt(std::abs(x)));
+	}
+
+	static double schwefel_26_finalize(double sum, std::size_t dim) {
+		return sum / dim;
+	}
+
+	static double rastrigin_term(std::size_t, double x) {
+		return std::pow(x, 2) - 10 * std::cos(2 * Pi * x) + 10;
+	}
+
 	static constexpr std::array functions = {
 		sphere, schwefel_12, rosenbrock, schwefel_26, rastrigin,
 		ackley, griewank